@@ -0,0 +1,804 @@
+// ==============================================================================
+/**
+ * bf-alloc.c
+ *
+ * A _best-fit_ heap allocator.  Like pb-alloc.c, it expands into one mmap()'d
+ * region by pointer bumping, but freed blocks are coalesced with their free
+ * neighbors and re-used.  Free blocks are indexed by a treap ordered by size
+ * (then address), so that the best fit is found in logarithmic time rather
+ * than by scanning a free list.  An aligned block is carved from an ordinary
+ * one, large enough to hold it at any offset, and records how far into that
+ * block it starts.
+ **/
+// ==============================================================================
+
+
+
+// ==============================================================================
+// INCLUDES
+
+#include <assert.h>
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "safeio.h"
+// ==============================================================================
+
+
+
+// ==============================================================================
+// MACRO CONSTANTS AND FUNCTIONS
+
+/** The system's page size. */
+#define PAGE_SIZE sysconf(_SC_PAGESIZE)
+
+/**
+ * Macros to easily calculate the number of bytes for larger scales (e.g., kilo,
+ * mega, gigabytes).
+ */
+#define KB(size)  ((size_t)size * 1024)
+#define MB(size)  (KB(size) * 1024)
+#define GB(size)  (MB(size) * 1024)
+
+/** The virtual address space reserved for the heap. */
+#define HEAP_SIZE GB(2)
+
+/** The alignment of every block returned by `malloc()`.  Must be a power of 2. */
+#define BLOCK_ALIGN 16
+
+/** Round `addr` up to the next multiple of `align`, which must be a power of 2. */
+#define ALIGN_UP(addr, align) (((addr) + ((intptr_t)(align) - 1)) & ~((intptr_t)(align) - 1))
+
+/**
+ * Flags kept in the low bits of `header_s.size`, which are otherwise always
+ * zero because block sizes are multiples of 8.
+ */
+#define IN_USE      ((size_t)0x1)
+#define PREV_IN_USE ((size_t)0x2)
+#define FLAGS       (IN_USE | PREV_IN_USE)
+
+/**
+ * Set instead in the word just before an aligned block that starts after the
+ * beginning of the block holding it, along with its offset into that block,
+ * which is a multiple of `BLOCK_ALIGN`.  No header ever has this bit set.
+ */
+#define ALIGNED_BLOCK ((size_t)0x4)
+
+/**
+ * The smallest useful portion of a block:  when the block is free, it must
+ * hold a tree node at its start and a copy of its size at its end.
+ */
+#define MIN_BLOCK_SIZE (sizeof(free_node_s) + sizeof(size_t))
+// ==============================================================================
+
+
+
+// ==============================================================================
+// TYPES AND STRUCTURES
+
+/** A header for each block's metadata. */
+typedef struct header {
+
+  /** The size of the useful portion of the block, in bytes, plus `FLAGS`. */
+  size_t size;
+
+} header_s;
+
+/**
+ * The tree node at the start of each free block.  The final word of a free
+ * block is a footer that repeats its size, so that the block after it can
+ * find it to coalesce.
+ */
+typedef struct free_node {
+
+  /** The free blocks that sort before this one. */
+  struct free_node* left;
+
+  /** The free blocks that sort after this one. */
+  struct free_node* right;
+
+} free_node_s;
+// ==============================================================================
+
+
+
+// ==============================================================================
+// GLOBALS
+
+/**
+ * The address of the next available byte in the heap region.  Everything from
+ * here to `end_addr` is the _wilderness_, which is not yet part of any block.
+ */
+static intptr_t free_addr  = 0;
+
+/** The beginning of the heap. */
+static intptr_t start_addr = 0;
+
+/** The end of the heap. */
+static intptr_t end_addr   = 0;
+
+/** The root of the treap of free blocks. */
+static free_node_s* free_tree = NULL;
+
+/** Serializes every operation on the heap. */
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * The initialization method.  If this is the first use of the heap, initialize
+ * it.  Must be called with `heap_lock` held.
+ */
+
+void init () {
+
+  // Only do anything if there is no heap region (i.e., first time called).
+  if (start_addr == 0) {
+
+    DEBUG("Trying to initialize");
+
+    // Allocate virtual address space in which the heap will reside. Make it
+    // un-shared and not backed by any file (_anonymous_ space).  A failure to
+    // map this space is fatal.
+    void* heap = mmap(NULL,
+		      HEAP_SIZE,
+		      PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS,
+		      -1,
+		      0);
+    if (heap == MAP_FAILED) {
+      ERROR("Could not mmap() heap region");
+    }
+
+    // Hold onto the boundaries of the heap as a whole.  The first header is
+    // placed so that the first block is aligned.
+    start_addr = (intptr_t)heap;
+    end_addr   = start_addr + HEAP_SIZE;
+    free_addr  = ALIGN_UP(start_addr + (intptr_t)sizeof(header_s), BLOCK_ALIGN)
+                 - sizeof(header_s);
+
+    // DEBUG: Emit a message to indicate that this allocator is being called.
+    DEBUG("bf-alloc initialized");
+
+  }
+
+} // init ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+// BLOCK NAVIGATION
+
+/** The size of the useful portion of a block, without the flags. */
+static size_t block_size (header_s* header) {
+  return header->size & ~FLAGS;
+}
+
+/** The header of the block that owns a free tree node (or a user pointer). */
+static header_s* node_header (void* node) {
+  return (header_s*)((intptr_t)node - sizeof(header_s));
+}
+
+/** The address just past the end of a block; the next block's header, if any. */
+static intptr_t block_end (header_s* header) {
+  return (intptr_t)header + sizeof(header_s) + block_size(header);
+}
+
+/**
+ * The start of the useful portion of the block that holds a block returned to
+ * the program, which differs from it only for an aligned block.
+ */
+static void* block_base (void* ptr) {
+
+  size_t word = node_header(ptr)->size;
+  return (word & ALIGNED_BLOCK) ? (void*)((intptr_t)ptr - (intptr_t)(word & ~ALIGNED_BLOCK)) : ptr;
+
+}
+
+/**
+ * The number of useful bytes needed for a request:  enough for `size`, at
+ * least `MIN_BLOCK_SIZE`, and such that the next header also lands just
+ * before an aligned address.
+ */
+static size_t request_size (size_t size) {
+
+  size_t needed = ALIGN_UP(size + sizeof(header_s), BLOCK_ALIGN) - sizeof(header_s);
+  return needed < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : needed;
+
+}
+// ==============================================================================
+
+
+
+// ==============================================================================
+// THE FREE TREE
+//
+// A treap keyed by (size, address).  Each node's priority is a hash of its
+// address, so that no priority need be stored and the expected depth is
+// logarithmic regardless of the order in which blocks are freed.
+
+/** Whether node `a` sorts before node `b`. */
+static bool node_before (free_node_s* a, free_node_s* b) {
+
+  size_t a_size = block_size(node_header(a));
+  size_t b_size = block_size(node_header(b));
+  return a_size < b_size || (a_size == b_size && a < b);
+
+}
+
+/** A node's treap priority. */
+static uint64_t node_priority (free_node_s* node) {
+  return (uint64_t)(intptr_t)node * 0x9e3779b97f4a7c15ull;
+}
+
+/**
+ * Join two treaps, where every node of `low` sorts before every node of
+ * `high`.
+ *
+ * \return The root of the joined treap.
+ */
+static free_node_s* tree_join (free_node_s* low, free_node_s* high) {
+
+  if (low == NULL) {
+    return high;
+  }
+  if (high == NULL) {
+    return low;
+  }
+  if (node_priority(low) > node_priority(high)) {
+    low->right = tree_join(low->right, high);
+    return low;
+  }
+  high->left = tree_join(low, high->left);
+  return high;
+
+} // tree_join ()
+
+/**
+ * Split a treap into the nodes that sort before `key` and the rest.
+ *
+ * \param root The treap to split.
+ * \param key  The node (not in the treap) at which to split.
+ * \param low  Where to store the root of the nodes before `key`.
+ * \param high Where to store the root of the nodes after `key`.
+ */
+static void tree_split (free_node_s*  root,
+			free_node_s*  key,
+			free_node_s** low,
+			free_node_s** high) {
+
+  if (root == NULL) {
+    *low  = NULL;
+    *high = NULL;
+  } else if (node_before(root, key)) {
+    *low = root;
+    tree_split(root->right, key, &root->right, high);
+  } else {
+    *high = root;
+    tree_split(root->left, key, low, &root->left);
+  }
+
+} // tree_split ()
+
+/** Add a free block to the tree. */
+static void tree_insert (free_node_s* node) {
+
+  free_node_s* low;
+  free_node_s* high;
+  tree_split(free_tree, node, &low, &high);
+  node->left  = NULL;
+  node->right = NULL;
+  free_tree   = tree_join(tree_join(low, node), high);
+
+} // tree_insert ()
+
+/** Remove a free block from the tree. */
+static void tree_remove (free_node_s* node) {
+
+  // Descend by key to the link that points at the node, then replace the node
+  // with the join of its subtrees.
+  free_node_s** link = &free_tree;
+  while (*link != node) {
+    assert(*link != NULL);
+    link = node_before(node, *link) ? &(*link)->left : &(*link)->right;
+  }
+  *link = tree_join(node->left, node->right);
+
+} // tree_remove ()
+
+/**
+ * Find the best fit:  the smallest free block with at least `size` useful
+ * bytes, taking the lowest address among equals.
+ *
+ * \return The node of the best-fitting block, or `NULL` if none is big enough.
+ */
+static free_node_s* tree_best_fit (size_t size) {
+
+  free_node_s* best = NULL;
+  free_node_s* node = free_tree;
+  while (node != NULL) {
+    if (block_size(node_header(node)) >= size) {
+      best = node;
+      node = node->left;
+    } else {
+      node = node->right;
+    }
+  }
+  return best;
+
+} // tree_best_fit ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Mark a block as free and add it to the tree.  The block after it (which
+ * must exist and be in use) learns that its predecessor is free.
+ *
+ * \param header The block's header.
+ * \param size   The size of the useful portion of the block.
+ */
+static void release_block (header_s* header, size_t size) {
+
+  // A free block never follows another free block, so its predecessor is in
+  // use.
+  header->size = size | PREV_IN_USE;
+  *(size_t*)(block_end(header) - sizeof(size_t)) = size;
+
+  header_s* next = (header_s*)block_end(header);
+  next->size    &= ~PREV_IN_USE;
+
+  tree_insert((free_node_s*)((intptr_t)header + sizeof(header_s)));
+
+} // release_block ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Take the first `size` useful bytes of an in-use block, and release what
+ * remains after them as a new free block if it is big enough to be one.
+ *
+ * \param header The block's header, already marked `IN_USE`.
+ * \param size   The number of useful bytes to keep, from `request_size()`.
+ */
+static void trim_block (header_s* header, size_t size) {
+
+  size_t have = block_size(header);
+  if (have - size < sizeof(header_s) + MIN_BLOCK_SIZE) {
+    return;
+  }
+
+  header->size         = size | (header->size & FLAGS);
+  header_s* remainder  = (header_s*)block_end(header);
+  release_block(remainder, have - size - sizeof(header_s));
+
+} // trim_block ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate and return `size` bytes of heap space.  Use the best-fitting free
+ * block if there is one; otherwise, expand into the heap region via _pointer
+ * bumping_.
+ *
+ * \param size The number of bytes to allocate.
+ * \return     A pointer to the allocated block, if successful; `NULL` if
+ *             unsuccessful.
+ */
+void* malloc (size_t size) {
+
+  // if requested size is 0, or can not possibly fit, there is nothing to do
+  if (size == 0 || size > HEAP_SIZE) {
+    return NULL;
+  }
+  size_t needed = request_size(size);
+
+  pthread_mutex_lock(&heap_lock);
+  init();
+
+  header_s*    header;
+  free_node_s* best = tree_best_fit(needed);
+  if (best != NULL) {
+
+    // Claim the best fit, telling its successor that it is now in use, and
+    // return any excess to the tree.
+    tree_remove(best);
+    header                            = node_header(best);
+    header->size                     |= IN_USE;
+    ((header_s*)block_end(header))->size |= PREV_IN_USE;
+    trim_block(header, needed);
+
+  } else {
+
+    // Bump the block out of the wilderness.  The block before the wilderness
+    // is always in use, since a free one would have been merged into it.
+    header = (header_s*)free_addr;
+    if (needed + sizeof(header_s) > (size_t)(end_addr - free_addr)) {
+      pthread_mutex_unlock(&heap_lock);
+      return NULL;
+    }
+    header->size = needed | IN_USE | PREV_IN_USE;
+    free_addr    = block_end(header);
+
+  }
+
+  pthread_mutex_unlock(&heap_lock);
+  return (void*)((intptr_t)header + sizeof(header_s));
+
+} // malloc()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Deallocate a given block on the heap.  Coalesce it with any free neighbors,
+ * and add the result to the free tree (or, if it borders on the wilderness,
+ * give it back to the wilderness).
+ *
+ * \param ptr A pointer to the block to be deallocated.
+ */
+void free (void* ptr) {
+
+  DEBUG("free(): ", (intptr_t)ptr);
+
+  if (ptr == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&heap_lock);
+
+  header_s* header = node_header(block_base(ptr));
+  size_t    size   = block_size(header);
+
+  // Absorb the next block if it is free.
+  intptr_t next_addr      = block_end(header);
+  bool     to_wilderness  = (next_addr == free_addr);
+  if (!to_wilderness) {
+    header_s* next = (header_s*)next_addr;
+    if (!(next->size & IN_USE)) {
+      tree_remove((free_node_s*)(next_addr + sizeof(header_s)));
+      size += sizeof(header_s) + block_size(next);
+    }
+  }
+
+  // Absorb the previous block if it is free, finding it through its footer.
+  if (!(header->size & PREV_IN_USE)) {
+    size_t    prev_size = *(size_t*)((intptr_t)header - sizeof(size_t));
+    header_s* prev      = (header_s*)((intptr_t)header - sizeof(header_s) - prev_size);
+    tree_remove((free_node_s*)((intptr_t)prev + sizeof(header_s)));
+    size  += sizeof(header_s) + prev_size;
+    header = prev;
+  }
+
+  if (to_wilderness) {
+    free_addr = (intptr_t)header;
+  } else {
+    release_block(header, size);
+  }
+
+  pthread_mutex_unlock(&heap_lock);
+
+} // free()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate a block of `nmemb * size` bytes on the heap, zeroing its contents.
+ *
+ * \param nmemb The number of elements in the new block.
+ * \param size  The size, in bytes, of each of the `nmemb` elements.
+ * \return      A pointer to the newly allocated and zeroed block, if successful;
+ *              `NULL` if unsuccessful.
+ */
+void* calloc (size_t nmemb, size_t size) {
+
+  // Refuse requests whose total size overflows.
+  size_t total_size;
+  if (__builtin_mul_overflow(nmemb, size, &total_size)) {
+    return NULL;
+  }
+
+  // Allocate a block of the requested size.
+  void* block_ptr = malloc(total_size);
+
+  // If the allocation succeeded, clear the entire block.
+  if (block_ptr != NULL) {
+    memset(block_ptr, 0, total_size);
+  }
+
+  return block_ptr;
+
+} // calloc ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Update the given block at `ptr` to take on the given `size`.  If `size` fits
+ * within the block, it is returned unchanged.  If the block is the last one
+ * before the wilderness, it is grown in place.  Otherwise, a new and larger
+ * block is allocated, the data copied, and the old block freed.
+ *
+ * \param ptr  The block to be assigned a new size.
+ * \param size The new size that the block should assume.
+ * \return     A pointer to the resultant block, which may be `ptr` itself, or
+ *             may be a newly allocated block.
+ */
+void* realloc (void* ptr, size_t size) {
+
+  // if there is no given block, then simply return
+  // a new block of given size using malloc()
+  if (ptr == NULL) {
+    return malloc(size);
+  }
+
+  // if the requested size is 0, then free the current block as
+  // it is no longer needed. Return NULL to signify a block of size 0.
+  if (size == 0) {
+    free(ptr);
+    return NULL;
+  }
+  if (size > HEAP_SIZE) {
+    return NULL;
+  }
+
+  void*     base     = block_base(ptr);
+  header_s* header   = node_header(base);
+  size_t    old_size = block_size(header) - ((intptr_t)ptr - (intptr_t)base);
+  if (size <= old_size) {
+    return ptr;
+  }
+
+  // Grow the last block before the wilderness in place, unless it is aligned
+  // within its block.
+  size_t needed = request_size(size);
+  pthread_mutex_lock(&heap_lock);
+  if (base == ptr && block_end(header) == free_addr &&
+      needed - old_size <= (size_t)(end_addr - free_addr)) {
+    header->size = needed | (header->size & FLAGS);
+    free_addr    = block_end(header);
+    pthread_mutex_unlock(&heap_lock);
+    return ptr;
+  }
+  pthread_mutex_unlock(&heap_lock);
+
+  // Otherwise, move the contents to a new block.
+  void* new_ptr = malloc(size);
+  if (new_ptr != NULL) {
+    memcpy(new_ptr, ptr, old_size);
+    free(ptr);
+  }
+
+  return new_ptr;
+
+} // realloc()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Find the number of usable bytes in a block, which may exceed the size it
+ * was requested with.
+ *
+ * \param ptr A pointer to a block, or `NULL`.
+ * \return    The block's usable size; `0` for `NULL`.
+ */
+size_t malloc_usable_size (void* ptr) {
+
+  if (ptr == NULL) {
+    return 0;
+  }
+  void* base = block_base(ptr);
+  return block_size(node_header(base)) - ((intptr_t)ptr - (intptr_t)base);
+
+} // malloc_usable_size ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes aligned to `align`:  take an ordinary block with room
+ * for `size` bytes at any aligned offset, and if the aligned block does not
+ * start it, record the offset in the word before the aligned block.
+ *
+ * \param align The alignment of the block; a power of 2.
+ * \param size  The number of bytes to allocate.
+ * \return      A pointer to the allocated block, if successful; `NULL` if
+ *              unsuccessful.
+ */
+static void* allocate_aligned (size_t align, size_t size) {
+
+  if (align <= BLOCK_ALIGN) {
+    return malloc(size);
+  }
+  if (size == 0 || size > HEAP_SIZE || align > HEAP_SIZE) {
+    return NULL;
+  }
+
+  // Every block is already aligned to BLOCK_ALIGN, so the aligned block starts
+  // at most align - BLOCK_ALIGN bytes into it.
+  void* base = malloc(size + align - BLOCK_ALIGN);
+  if (base == NULL) {
+    return NULL;
+  }
+  intptr_t block_addr = ALIGN_UP((intptr_t)base, align);
+  if (block_addr != (intptr_t)base) {
+    node_header((void*)block_addr)->size = (size_t)(block_addr - (intptr_t)base) | ALIGNED_BLOCK;
+  }
+  return (void*)block_addr;
+
+} // allocate_aligned ()
+
+/** Determine whether `value` is a power of 2. */
+static bool is_power_of_2 (size_t value) {
+  return value != 0 && (value & (value - 1)) == 0;
+}
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes aligned to `alignment`, storing the block in
+ * `*memptr`.
+ *
+ * \param memptr    Where to store the pointer to the allocated block.
+ * \param alignment A power of 2 that is a multiple of `sizeof(void*)`.
+ * \param size      The number of bytes to allocate.
+ * \return          `0` if successful; `EINVAL` if `alignment` is invalid;
+ *                  `ENOMEM` if there is no space.
+ */
+int posix_memalign (void** memptr, size_t alignment, size_t size) {
+
+  if (!is_power_of_2(alignment) || alignment % sizeof(void*) != 0) {
+    return EINVAL;
+  }
+
+  void* block_ptr = allocate_aligned(alignment, size);
+  if (block_ptr == NULL && size != 0) {
+    return ENOMEM;
+  }
+
+  *memptr = block_ptr;
+  return 0;
+
+} // posix_memalign ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes aligned to `alignment`, as in C11.
+ *
+ * \param alignment A power of 2.
+ * \param size      The number of bytes to allocate.
+ * \return          A pointer to the allocated block, if successful; `NULL` if
+ *                  unsuccessful.
+ */
+void* aligned_alloc (size_t alignment, size_t size) {
+
+  if (!is_power_of_2(alignment)) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  return allocate_aligned(alignment, size);
+
+} // aligned_alloc ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes aligned to `alignment`.  As in glibc, an alignment
+ * that is not a power of 2 is rounded up to one.
+ *
+ * \param alignment The alignment of the block.
+ * \param size      The number of bytes to allocate.
+ * \return          A pointer to the allocated block, if successful; `NULL` if
+ *                  unsuccessful.
+ */
+void* memalign (size_t alignment, size_t size) {
+
+  if (alignment > HEAP_SIZE) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (alignment > BLOCK_ALIGN && !is_power_of_2(alignment)) {
+    alignment = (size_t)1 << (64 - __builtin_clzll(alignment));
+  }
+
+  return allocate_aligned(alignment, size);
+
+} // memalign ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes aligned to a page.
+ *
+ * \param size The number of bytes to allocate.
+ * \return     A pointer to the allocated block, if successful; `NULL` if
+ *             unsuccessful.
+ */
+void* valloc (size_t size) {
+
+  return allocate_aligned(PAGE_SIZE, size);
+
+} // valloc ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes, rounded up to a whole number of pages, aligned to a
+ * page.
+ *
+ * \param size The number of bytes to allocate.
+ * \return     A pointer to the allocated block, if successful; `NULL` if
+ *             unsuccessful.
+ */
+void* pvalloc (size_t size) {
+
+  size_t page_size = PAGE_SIZE;
+  if (size > HEAP_SIZE) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  return allocate_aligned(page_size, size == 0 ? page_size : ALIGN_UP(size, page_size));
+
+} // pvalloc ()
+// ==============================================================================
+
+
+
+#if defined (ALLOC_MAIN)
+// ==============================================================================
+/**
+ * The entry point if this code is compiled as a standalone program for testing
+ * purposes.
+ */
+int main () {
+
+  // Allocate a few blocks, then free them.
+  void* x = malloc(16);
+  void* y = malloc(64);
+  void* z = malloc(32);
+
+  free(z);
+  free(y);
+  free(x);
+
+  return 0;
+
+} // main()
+// ==============================================================================
+#endif
@@ -4,6 +4,99 @@
  *
  * A _pointer-bumping_ heap allocator.  This allocator *does not re-use* freed
  * blocks.  It uses _pointer bumping_ to expand the heap with each allocation.
+ *
+ * When compiled with `RECYCLE_ALLOC`, requests up to `CLASS_MAX` bytes are
+ * rounded up to a size class, and freed blocks are kept on per-thread,
+ * per-class free lists from which `malloc()` takes them before bumping.  A
+ * block freed by another thread than the one whose chunk it was carved from
+ * is pushed onto that thread's remote-free queue, without a lock, and the
+ * owner moves the whole queue onto its free lists once a list runs dry.  An
+ * exiting thread leaves its queue, with its free lists on it, to the next new
+ * thread.
+ *
+ * When compiled with `HEADERLESS_ALLOC`, requests up to `HEADERLESS_MAX` bytes
+ * are instead packed into pages devoted to a single size class.  Such blocks
+ * have no header; a table with one byte per page records each page's class.
+ *
+ * When compiled with `HARDENED_ALLOC`, every block is bracketed by canaries:
+ * one in its header, beside its size, and one in the word directly after its
+ * usable bytes, both derived from the block's address and a secret drawn at
+ * startup.  `free()` and `realloc()` check both, and on finding either
+ * overwritten, report it and `abort()`, running no exit handlers on the
+ * corrupt heap.  Optionally, each large block is followed by an inaccessible
+ * guard page as well, so that an overrun faults as soon as it leaves the
+ * block.  (Headerless blocks have nowhere to keep a canary, so hardening
+ * disables `HEADERLESS_ALLOC`.)
+ *
+ * Requests larger than `MMAP_THRESHOLD` bytes are not bumped from the heap at
+ * all.  Each gets a mapping of its own, which `free()` unmaps and `realloc()`
+ * grows with `mremap()`.
+ *
+ * With huge pages enabled, the heap is aligned to `HUGE_PAGE` and marked for
+ * transparent huge pages, so that the kernel can back it with fewer, larger
+ * pages as it is committed.  Compiling with `HUGEPAGE_ALLOC` enables them by
+ * default.
+ *
+ * With prefaulting enabled, part of the heap is populated when it is created,
+ * and from then on the pages within `PREFAULT_AHEAD` of its bump pointer are
+ * populated before they are handed out, so that allocation does not take page
+ * faults.
+ *
+ * `init()` reads these settings from the environment, without allocating:
+ *
+ *   PB_HEAP_SIZE  The address space to reserve for the heap (`HEAP_SIZE`).
+ *   PB_ALIGN      The alignment of every block, a power of 2 no less than
+ *                 `BLOCK_ALIGN`.  Above `CLASS_SPACING`, no block is
+ *                 headerless.
+ *   PB_TLAB_SIZE  The size of each thread's chunk of the heap (`TLAB_SIZE`),
+ *                 rounded up to a power of 2.
+ *   PB_HUGEPAGES  Whether to use huge pages (`1`, `0`, or similar).
+ *   PB_PREFAULT   How much of the heap to populate up front; `0` disables
+ *                 prefaulting.
+ *   PB_STATS      Whether to print the statistics of `pb_stats()` at exit.
+ *   PB_SAMPLE_INTERVAL
+ *                 The mean number of bytes allocated between samples taken
+ *                 for the profiler; `0`, the default, disables it.
+ *   PB_PROFILE    The file to which to write the profile at exit.
+ *   PB_NUMA       Whether to divide the heap by NUMA node, if there is more
+ *                 than one (`1`, the default, `0`, or similar).
+ *   PB_PURGE      How many bytes of recycled blocks a thread may hold before
+ *                 their pages are released (`PURGE_THRESHOLD`); `0` disables
+ *                 returning memory to the system.
+ *   PB_TRACE      A prefix for the names of trace files; if set, each thread
+ *                 records its calls (see pb-trace.h) to `<prefix>.<pid>.<n>`.
+ *   PB_GUARD_PAGES
+ *                 With `HARDENED_ALLOC`, whether to follow each large block
+ *                 with a guard page (`1`, `0`, the default, or similar).
+ *
+ * Sizes are given in bytes, with an optional `K`, `M`, or `G` suffix.
+ *
+ * On a machine with several NUMA nodes, the heap is divided into one region
+ * per node, each bound to its node's memory with `mbind()`, and each thread
+ * takes its chunks and its other heap space from the region of the node that
+ * it is running on.  (Prefaulting is then disabled:  it would populate only
+ * one of the regions.)
+ *
+ * Freed memory is returned to the system.  Without recycling, no block is
+ * ever reused, so once every block bumped from a thread's chunk has been
+ * freed, and the thread has moved on to another, the whole chunk's pages are
+ * released with `MADV_DONTNEED`.  (Headerless pages outlive the chunk that
+ * they are carved from, so `HEADERLESS_ALLOC` disables this.)  With
+ * recycling, once a thread's free lists hold more than `PB_PURGE` bytes of
+ * blocks of at least `PURGE_BLOCK_MIN`, the pages within those blocks,
+ * beyond the first, are released with `MADV_FREE`, so that reusing a block
+ * costs nothing unless the system has since reclaimed its pages.
+ *
+ * The allocator is safe to `fork()` from a multithreaded process:  handlers
+ * registered with `pthread_atfork()` hold its locks across the fork, and
+ * in the child, release the state of the threads that did not survive it.
+ * `mallinfo2()` (and `mallinfo()`) report on the heap from the allocator's
+ * own accounting, and `malloc_trim()` returns the committed space beyond each
+ * heap region's bump pointer, along with the calling thread's recycled
+ * blocks' pages, to the system.
+ *
+ * Arenas (see pb-alloc.h) are further regions of their own, bumped in the same
+ * way as the heap but released all at once.
  **/
 // ==============================================================================
 
@@ -12,15 +105,32 @@
 // ==============================================================================
 // INCLUDES
 
+#define _GNU_SOURCE
+
 #include <assert.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sched.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/random.h>
+#include <sys/syscall.h>
+
+#if defined (__x86_64__) || defined (__i386__)
+#include <x86intrin.h>
+#endif
 
+#include "pb-alloc.h"
+#include "pb-trace.h"
 #include "safeio.h"
 // ==============================================================================
 
@@ -29,6 +139,11 @@
 // ==============================================================================
 // MACRO CONSTANTS AND FUNCTIONS
 
+/** Headerless blocks would have no room for canaries. */
+#if defined (HARDENED_ALLOC)
+#undef HEADERLESS_ALLOC
+#endif /* HARDENED_ALLOC */
+
 /** The system's page size. */
 #define PAGE_SIZE sysconf(_SC_PAGESIZE)
 
@@ -40,8 +155,178 @@
 #define MB(size)  (KB(size) * 1024)
 #define GB(size)  (MB(size) * 1024)
 
-/** The virtual address space reserved for the heap. */
-#define HEAP_SIZE GB(2)
+/**
+ * The virtual address space reserved for the heap by default.  The reservation
+ * is inaccessible, and so costs nothing, until parts of it are committed.
+ */
+#define HEAP_SIZE GB(64)
+
+/**
+ * The least and the most by which the committed part of the heap grows at a
+ * time.  Between the two, each growth doubles what is already committed.
+ */
+#define COMMIT_MIN MB(4)
+#define COMMIT_MAX GB(1)
+
+/**
+ * The size of a transparent huge page.  With huge pages enabled, the heap
+ * starts on such a boundary, and since `COMMIT_MIN` is a multiple of it, so does every
+ * committed extent.
+ */
+#define HUGE_PAGE MB(2)
+
+/**
+ * The least, and default, alignment of every block returned by `malloc()`.
+ * Must be a power of 2.
+ */
+#define BLOCK_ALIGN 16
+
+/** Round `addr` up (or down) to a multiple of `align`, which must be a power of 2. */
+#define ALIGN_UP(addr, align)   (((addr) + ((intptr_t)(align) - 1)) & ~((intptr_t)(align) - 1))
+#define ALIGN_DOWN(addr, align) ((addr) & ~((intptr_t)(align) - 1))
+
+/**
+ * The default size of the chunk that each thread carves from the shared heap
+ * and then bump-allocates from privately, and the limits on what may be set.
+ */
+#define TLAB_SIZE     MB(1)
+#define TLAB_SIZE_MIN KB(64)
+#define TLAB_SIZE_MAX GB(1)
+
+/**
+ * The largest request served from a thread's chunk.  Anything bigger would
+ * waste too much of the chunk, so it is bumped directly from the shared heap.
+ */
+#define TLAB_MAX_BLOCK (config.tlab_size / 8)
+
+/**
+ * Storage class for per-thread state.  The _initial-exec_ model resolves to a
+ * fixed offset from the thread pointer, so access never goes through
+ * `__tls_get_addr()`, which may itself call `malloc()`.
+ */
+#define THREAD_LOCAL __thread __attribute__ ((tls_model ("initial-exec")))
+
+/** The bytes after each block's usable bytes that hold its trailing canary. */
+#if defined (HARDENED_ALLOC)
+#define TRAILER_SIZE sizeof(uint64_t)
+#else
+#define TRAILER_SIZE 0
+#endif /* HARDENED_ALLOC */
+
+/** The spacing of the small size classes, which is also the smallest class. */
+#define CLASS_SPACING 16
+
+/** The largest of the evenly spaced small size classes. */
+#define SMALL_CLASS_MAX KB(1)
+
+/** The number of small size classes. */
+#define SMALL_CLASSES (SMALL_CLASS_MAX / CLASS_SPACING)
+
+/**
+ * The largest size class.  Between `SMALL_CLASS_MAX` and here, each class is
+ * a power of two; larger blocks are never recycled.
+ */
+#define CLASS_MAX KB(256)
+
+/** The total number of size classes, small and power-of-two. */
+#define NUM_CLASSES (SMALL_CLASSES + 8)
+
+/**
+ * The size of a page devoted to headerless blocks of one size class, and the
+ * granularity of the table that records those classes.
+ */
+#define CLASS_PAGE KB(4)
+
+/** The largest request that is given a headerless block. */
+#define HEADERLESS_MAX 256
+
+/** The number of size classes whose blocks are headerless. */
+#define HEADERLESS_CLASSES (HEADERLESS_MAX / CLASS_SPACING)
+
+/**
+ * The largest request bumped from the heap.  Larger ones get mappings of their
+ * own, so that `realloc()` can move their pages rather than copy them.
+ */
+#define MMAP_THRESHOLD KB(256)
+
+/**
+ * With prefaulting enabled, the distance ahead of the heap's bump pointer up to
+ * which its pages are kept populated.
+ */
+#define PREFAULT_AHEAD MB(8)
+
+/** Populate pages as if written; older C libraries lack the name. */
+#if !defined (MADV_POPULATE_WRITE)
+#define MADV_POPULATE_WRITE 23
+#endif
+
+/**
+ * Add to one of the calling thread's statistics counters (or, with
+ * `COUNT_TO()`, to one in a record already found).  Only that thread writes
+ * them, so a relaxed load and store suffice, without a locked instruction.
+ */
+#define COUNT_TO(record, field, n)					\
+  __atomic_store_n(&(record)->field, (record)->field + (n), __ATOMIC_RELAXED)
+#define COUNT(field, n)							\
+  do {									\
+    thread_stats_s* counts_ = my_stats();				\
+    COUNT_TO(counts_, field, n);					\
+  } while (0)
+
+/** The most frames recorded in the stack trace of a sampled allocation. */
+#define SAMPLE_DEPTH 32
+
+/**
+ * The number of samples that the profiler keeps.  Once that many have been
+ * taken, each new sample overwrites the oldest.  Must be a power of 2.
+ */
+#define SAMPLE_RING 4096
+
+/**
+ * The size of the window through which a thread writes its trace file.  The
+ * file is extended by a window at a time, ahead of the records written to it.
+ */
+#define TRACE_WINDOW MB(4)
+
+/** The most NUMA nodes across which the heap is divided. */
+#define NUMA_NODES_MAX 64
+
+/**
+ * The memory policy that binds each node's region:  its pages come from the
+ * node while it has any free, and from elsewhere only once it is full.
+ * Defined here rather than taken from libnuma, which is not otherwise needed.
+ */
+#if !defined (MPOL_PREFERRED)
+#define MPOL_PREFERRED 1
+#endif
+
+/**
+ * By default, how many bytes of recycled blocks a thread may hold before the
+ * pages within them are released.
+ */
+#define PURGE_THRESHOLD MB(64)
+
+/** The smallest recycled block whose pages are released. */
+#define PURGE_BLOCK_MIN KB(16)
+
+/**
+ * Whether a chunk of the heap can be known to be dead:  only if blocks are
+ * never reused, nor carved from a chunk after it has been replaced.
+ */
+#if !defined (RECYCLE_ALLOC) && !defined (HEADERLESS_ALLOC)
+#define CHUNK_PURGE
+#endif
+
+/** The states of a chunk of the heap. */
+#define CHUNK_NONE   0
+#define CHUNK_OPEN   1
+#define CHUNK_SEALED 2
+#define CHUNK_PURGED 3
+
+/** The states through which `init()` moves the heap. */
+#define HEAP_UNINITIALIZED 0
+#define HEAP_INITIALIZING  1
+#define HEAP_READY         2
 // ==============================================================================
 
 
@@ -51,247 +336,3726 @@
 /** A header for each block's metadata. */
 typedef struct header {
 
+#if defined (HARDENED_ALLOC)
+  /**
+   * The block's leading canary.  It lies between the block before and this
+   * block's size, so an overrun of the one reaches it before the other.
+   */
+  uint64_t canary;
+#endif /* HARDENED_ALLOC */
+
   /** The size of the useful portion of the block, in bytes. */
   size_t size;
   
 } header_s;
-// ==============================================================================
 
+/**
+ * A thread-local allocation buffer:  a chunk of the heap owned by a single
+ * thread, which can therefore bump through it without atomic operations.
+ */
+typedef struct tlab {
 
+  /** The address of the next available byte in the chunk. */
+  intptr_t free_addr;
 
-// ==============================================================================
-// GLOBALS
+  /** The end of the chunk. */
+  intptr_t end_addr;
 
-/** The address of the next available byte in the heap region. */
-static intptr_t free_addr  = 0;
+} tlab_s;
 
-/** The beginning of the heap. */
-static intptr_t start_addr = 0;
+/**
+ * A region of address space that is allocated by pointer bumping:  the heap
+ * itself, or an arena.  The region is reserved up front and committed as the
+ * bump pointer advances.
+ */
+typedef struct region {
+
+  /** The beginning of the region. */
+  intptr_t start_addr;
+
+  /** The end of the region. */
+  intptr_t end_addr;
+
+  /**
+   * The end of the committed part of the region, below which every byte is
+   * readable and writable.  Only ever changed while `heap_lock` is held:
+   * raised by `region_commit()`, and lowered by `region_trim()`, which stores
+   * the lowered value before it reads `free_addr`.  A reservation advances
+   * `free_addr` before it reads this, both sequentially consistent, so either
+   * the trim sees the reservation and keeps its space, or the reservation
+   * sees the lowered value and recommits.
+   */
+  intptr_t commit_addr;
+
+  /**
+   * The address of the next available byte in the region.  Shared by all
+   * threads, so it is only ever read and advanced atomically; it has a cache
+   * line to itself, so that advancing it does not disturb readers of the
+   * boundaries above.
+   */
+  intptr_t free_addr __attribute__ ((aligned (64)));
+
+} region_s;
 
-/** The end of the heap. */
-static intptr_t end_addr   = 0;
-// ==============================================================================
+/**
+ * An arena:  a region of its own, for blocks that are never freed one at a
+ * time, but all at once by `pb_arena_reset()`.  The arena's descriptor lives at
+ * the start of its own region.
+ */
+struct pb_arena {
 
+  /** The arena's region. */
+  region_s region;
 
+  /** The address of the first byte after the descriptor. */
+  intptr_t base_addr;
+
+};
+
+/** The settings that `init()` reads from the environment. */
+typedef struct config {
+
+  /** The address space reserved for the heap. */
+  size_t heap_size;
+
+  /** The alignment of every block returned by `malloc()`. */
+  size_t align;
+
+  /** The size of each thread's chunk of the heap. */
+  size_t tlab_size;
+
+  /** Whether the heap is marked for transparent huge pages. */
+  bool   hugepages;
+
+  /** How much of the heap to populate up front; `0` disables prefaulting. */
+  size_t prefault_size;
+
+  /** Whether to print the statistics at exit. */
+  bool   stats;
+
+  /** The mean number of bytes between profiling samples; `0` if disabled. */
+  size_t sample_interval;
+
+  /** The prefix of the names of trace files; `NULL` if not tracing. */
+  const char* trace_prefix;
+
+  /** The recycled bytes that a thread may hold unpurged; `0` if never purging. */
+  size_t purge_threshold;
+
+  /** The number of NUMA nodes with regions of the heap; `0` if it is undivided. */
+  int    numa_nodes;
+
+  /** The bytes of guard after each large block; `0` if none. */
+  size_t guard_size;
+
+} config_s;
 
-// ==============================================================================
 /**
- * The initialization method.  If this is the first use of the heap, initialize it.
+ * One thread's statistics counters (see `pb_stats_t`).  Records are never
+ * freed:  when a thread exits, its record is left for a new thread to adopt, so
+ * that the sum over all records covers every thread there has ever been.
  */
+typedef struct thread_stats {
+
+  size_t malloc_calls;
+  size_t calloc_calls;
+  size_t realloc_calls;
+  size_t free_calls;
+  size_t bytes_requested;
+  size_t bytes_consumed;
+  size_t bytes_header;
+  size_t bytes_padding;
+  size_t bytes_rounding;
+  size_t size_histogram[PB_SIZE_BUCKETS];
+  size_t realloc_in_place;
+  size_t realloc_remaps;
+  size_t realloc_copies;
+
+  /** The next record, in the list of all of them.  Fixed once it is listed. */
+  struct thread_stats* next;
+
+  /** Whether a live thread owns the record. */
+  int in_use;
+
+#if defined (CHUNK_PURGE)
+  /**
+   * The owner's chunk and its count of the blocks bumped from it, so that a
+   * forked child can seal the chunks of threads that did not survive the fork.
+   */
+  tlab_s* tlab;
+  size_t* tlab_allocs;
+#endif /* CHUNK_PURGE */
+
+} thread_stats_s;
 
-void init () {
+/**
+ * A sampled allocation, in the profiler's ring.  The sequence number guards
+ * the rest:  a writer zeroes it before filling in the sample, and a reader
+ * keeps a copy of the sample only if the number was the same, and not zero,
+ * both before and after copying.
+ */
+typedef struct sample {
 
-  // Only do anything if there is no heap region (i.e., first time called).
-  if (start_addr == 0) {
+  /** One more than the number of the sample in the order taken; `0` while it is written. */
+  size_t seq;
 
-    DEBUG("Trying to initialize");
-    
-    // Allocate virtual address space in which the heap will reside. Make it
-    // un-shared and not backed by any file (_anonymous_ space).  A failure to
-    // map this space is fatal.
-    void* heap = mmap(NULL,
-		      HEAP_SIZE,
-		      PROT_READ | PROT_WRITE,
-		      MAP_PRIVATE | MAP_ANONYMOUS,
-		      -1,
-		      0);
-    if (heap == MAP_FAILED) {
-      ERROR("Could not mmap() heap region");
-    }
+  /** The number of bytes requested. */
+  size_t size;
 
-    // Hold onto the boundaries of the heap as a whole.
-    start_addr = (intptr_t)heap;
-    end_addr   = start_addr + HEAP_SIZE;
-    free_addr  = start_addr;
+  /** The number of frames in the stack trace. */
+  int    depth;
 
-    // DEBUG: Emit a message to indicate that this allocator is being called.
-    DEBUG("bp-alloc initialized");
+  /** The return addresses of the stack trace, innermost first. */
+  void*  frames[SAMPLE_DEPTH];
 
-  }
+} sample_s;
 
-} // init ()
-// ==============================================================================
+/** A buffer through which output is written to a file, without allocating. */
+typedef struct output {
 
+  /** The file descriptor to write to. */
+  int    fd;
+
+  /** The number of bytes in the buffer. */
+  size_t length;
+
+  /** The bytes not yet written. */
+  char   buffer[4096];
+
+} output_s;
 
-// ==============================================================================
 /**
- * Allocate and return `size` bytes of heap space.  Expand into the heap region
- * via _pointer bumping_.
- *
- * \param size The number of bytes to allocate.
+ * A thread's trace:  its file, and the window of the file, mapped shared, into
+ * which its records are written.  What is written to the window is in the file
+ * at once, so a trace survives even a crash of the process.
+ */
+typedef struct trace {
 
- * \return A pointer to the allocated block, if successful; `NULL` if
- *         unsuccessful.
+  /** The trace file. */
+  int    fd;
+
+  /** Whether the thread can trace no more:  it has exited, or a call failed. */
+  bool   done;
+
+  /** The offset in the file at which the window starts. */
+  off_t  window_offset;
+
+  /** The window, if one is mapped; otherwise `NULL`. */
+  char*  window;
+
+  /** Where in the window the next record goes. */
+  pb_trace_record_t* next;
+
+  /** The end of the window. */
+  char*  end;
+
+} trace_s;
+
+/**
+ * Whether a chunk of the heap, bumped by a single thread, is dead.  The owner
+ * counts its blocks privately, and only publishes the count when it replaces
+ * the chunk; any thread that frees a block in the chunk counts that too.
+ * Whichever of them finds the two counts equal, once the chunk is sealed,
+ * releases its pages.
  */
-void* malloc (size_t size) {
-  //initialize the heap if there is no heap region yet
-  init();
-  
-  // if requested size is 0, return nothing because there is nothing to do
-  if (size == 0) {
-    return NULL;
-  }
+typedef struct chunk {
 
-  // pad the address by the following:
-  // if there are less than 8 bytes until next double word alignment
-  // that means we can't fit a header before the next double word alignment
-  // so then shift the free_addr pointer forward 16 bytes and align it to the next
-  // double word alignment
-  // else align the free_addr pointer to the next double word alignment
-  // in both cases subtract 8 bytes from the double word alignment at the end
-  // in order to line up the header so the block is created at the
-  // double word alignment
-  if( free_addr % 16 < 8){
-    //free_addr = free_addr + 16 + (16 - free_addr % 16) - 8;
-    free_addr = free_addr + 24 - (free_addr % 16);
-  } else {
-    //free_addr = free_addr + (16 - free_addr % 16) - 8;
-    free_addr = free_addr + 8 - (free_addr % 16);
-  }
-  
-  // the total allocated block size will be:
-  // the requested size plus the size of its metadata header
-  // store this value in total_size
-  size_t    total_size = size + sizeof(header_s);
-  
-  // place the pointer for the header at the next free address in
-  // the virtual address space which is stored in free_addr
-  header_s* header_ptr = (header_s*)free_addr;
+  /** The number of blocks in the chunk that have been freed. */
+  size_t frees;
 
-  // place the pointer for the allocated block after the header
-  // this address will be at the next free address plus whatever
-  // the size of the header is
-  void*     block_ptr  = (void*)(free_addr + sizeof(header_s));
+  /** Once the chunk is sealed, the number of blocks bumped from it. */
+  size_t total;
 
-  // shift free_addr pointer down the heap total_size bytes
-  // to mark where the new free_addr is and store this new free_addr
-  intptr_t new_free_addr = free_addr + total_size;
+  /** One of the `CHUNK_` states. */
+  int    state;
 
-  // if new_free_addr is beyond the end of the heap, return null
-  // to signify that the heap is full when the next allocation is attempted
-  // else make new_free_addr the new free_addr 
-  if (new_free_addr > end_addr) {
+} __attribute__ ((aligned (32))) chunk_s;
 
-    return NULL;
+/** A recycled block, linked through its (no longer useful) contents. */
+typedef struct free_block {
 
-  } else {
+  /** The next block of the same size class. */
+  struct free_block* next;
 
-    free_addr = new_free_addr;
+  /** Whether the block's pages, beyond the first, have been released. */
+  bool purged;
 
-  }
-  
-  // store the size of the allocated block in its header
-  header_ptr->size = size;
+  /** The block's size class, while it waits on a remote-free queue. */
+  int  class;
 
-  //return the pointer to the allocated block
-  return block_ptr;
+} free_block_s;
 
-} // malloc()
+/**
+ * A thread's remote-free queue:  the blocks of its chunks that other threads
+ * have freed.  Any thread may push onto it; only its owner takes from it, and
+ * then the whole queue at once, so that a pushed block is never popped while
+ * another thread reads its link.  Like a statistics record, a queue is never
+ * freed:  when its thread exits, it is left for a new thread to adopt, along
+ * with the chunks that it serves.
+ */
+typedef struct remote_queue {
+
+  /** The next queue, in the list of all of them. */
+  struct remote_queue* next;
+
+  /** Whether a thread owns the queue. */
+  int in_use;
+
+  /**
+   * The owner's free lists, so that a forked child can hand on the blocks of
+   * threads that did not survive the fork.
+   */
+  free_block_s** free_lists;
+
+  /** The most recently pushed block; on a cache line of its own, as pushers write it. */
+  free_block_s* head __attribute__ ((aligned (64)));
+
+} remote_queue_s;
 // ==============================================================================
 
 
 
 // ==============================================================================
+// GLOBALS
+
 /**
- * Deallocate a given block on the heap.  Add the given block (if any) to the
- * free list.
- *
- * \param ptr A pointer to the block to be deallocated.
+ * The heap region, from which all threads allocate.  When the heap is divided
+ * by NUMA node, only its boundaries are used, and the space is bumped from
+ * `node_heaps` instead.
  */
-void free (void* ptr) {
+static region_s heap;
 
-  DEBUG("free(): ", (intptr_t)ptr);
+/** When the heap is divided by NUMA node, each node's region of it. */
+static region_s node_heaps[NUMA_NODES_MAX];
 
-} // free()
+/** The size of each node's region. */
+static size_t   node_heap_size;
+
+/** The NUMA node of the calling thread, as of its last new chunk. */
+static THREAD_LOCAL int thread_node = 0;
+
+/** Serializes the slow paths that change the mappings of the heap or arenas. */
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Whether the heap region exists yet; see `HEAP_READY` and friends. */
+static int      heap_state = HEAP_UNINITIALIZED;
+
+/** The settings in force; the defaults until `init()` reads the environment. */
+static config_s config = {
+  .heap_size     = HEAP_SIZE,
+  .align         = BLOCK_ALIGN,
+  .tlab_size     = TLAB_SIZE,
+#if defined (HUGEPAGE_ALLOC)
+  .hugepages     = true,
+#else
+  .hugepages     = false,
+#endif
+  .prefault_size = 0,
+  .stats           = false,
+  .sample_interval = 0,
+  .trace_prefix    = NULL,
+  .purge_threshold = PURGE_THRESHOLD,
+  .numa_nodes      = 0,
+  .guard_size      = 0
+};
+
+/** Every thread's statistics record, newest first. */
+static thread_stats_s* all_stats = NULL;
+
+/**
+ * The counters of threads that could not get a record of their own, or that
+ * are exiting.  Shared, so their updates may occasionally be lost.
+ */
+static thread_stats_s orphan_stats;
+
+/** Releases a thread's statistics record when the thread exits. */
+static pthread_key_t stats_key;
+
+/** The calling thread's statistics record, once it has one. */
+static THREAD_LOCAL thread_stats_s* thread_stats = NULL;
+
+/** The profiler's ring of samples; `NULL` unless profiling. */
+static sample_s* samples = NULL;
+
+/** The number of samples ever taken, including any overwritten since. */
+static size_t sample_count = 0;
+
+/**
+ * The bytes that the calling thread may yet allocate before its next sample.
+ * Once it goes negative, the thread takes the sample and draws a new
+ * distance.
+ */
+static THREAD_LOCAL intptr_t bytes_until_sample = 0;
+
+/** The state of the calling thread's generator of sampling distances; `0` until seeded. */
+static THREAD_LOCAL uint64_t sample_random = 0;
+
+/** Whether the calling thread is taking a sample, and so must not take another. */
+static THREAD_LOCAL bool sampling = false;
+
+/** Closes a thread's trace when the thread exits. */
+static pthread_key_t trace_key;
+
+/** The number of threads that have started traces. */
+static uint32_t trace_threads = 0;
+
+/** The calling thread's trace; nothing is open until its first call. */
+static THREAD_LOCAL trace_s trace_state;
+
+/** The end of the populated part of the heap.  Only advanced under `prefault_lock`. */
+static intptr_t populate_addr;
+
+/** Held by whichever thread is populating the heap; the others never wait for it. */
+static pthread_mutex_t prefault_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** The calling thread's chunk of the heap; empty until its first allocation. */
+static THREAD_LOCAL tlab_s tlab;
+
+/** The bytes of the heap released to the system, ever. */
+static size_t bytes_purged = 0;
+
+/** The number of large blocks with mappings of their own, and their bytes. */
+static size_t mapped_blocks = 0;
+static size_t mapped_bytes  = 0;
+
+#if defined (HARDENED_ALLOC)
+/** The secret from which every block's canary is derived. */
+static uint64_t canary_secret;
+#endif /* HARDENED_ALLOC */
+
+#if defined (CHUNK_PURGE)
+/**
+ * For each `tlab_size` of the heap, the state of the chunk aligned there, if a
+ * thread has bumped through it; `NULL` if never purging.
+ */
+static chunk_s* chunks = NULL;
+
+/** The base-2 logarithm of `tlab_size`. */
+static int chunk_shift;
+
+/** The number of blocks bumped from the calling thread's chunk. */
+static THREAD_LOCAL size_t tlab_allocs = 0;
+#endif /* CHUNK_PURGE */
+
+#if defined (RECYCLE_ALLOC)
+/** The calling thread's recycled blocks, one list per size class. */
+static THREAD_LOCAL free_block_s* free_lists[NUM_CLASSES];
+
+/** The bytes of the calling thread's recycled blocks not yet purged. */
+static THREAD_LOCAL size_t unpurged_bytes = 0;
+
+/**
+ * For each `tlab_size` of the heap, the remote-free queue of the thread whose
+ * chunk is aligned there, if any; `NULL` if the table could not be mapped.
+ */
+static remote_queue_s** chunk_owners = NULL;
+
+/** The base-2 logarithm of `tlab_size`. */
+static int chunk_shift;
+
+/** Every remote-free queue, newest first. */
+static remote_queue_s* all_queues = NULL;
+
+/** Hands a thread's remote-free queue on when the thread exits. */
+static pthread_key_t queue_key;
+
+/** The calling thread's remote-free queue, once it has a chunk. */
+static THREAD_LOCAL remote_queue_s* my_queue = NULL;
+#endif /* RECYCLE_ALLOC */
+
+#if defined (HEADERLESS_ALLOC)
+/**
+ * For each `CLASS_PAGE` of the heap, one more than the size class of the
+ * headerless blocks that it holds, or `0` if its blocks have headers.
+ */
+static uint8_t* page_classes = NULL;
+
+/** The calling thread's current page for each headerless size class. */
+static THREAD_LOCAL tlab_s class_pages[HEADERLESS_CLASSES];
+#endif /* HEADERLESS_ALLOC */
 // ==============================================================================
 
 
 
 // ==============================================================================
 /**
- * Allocate a block of `nmemb * size` bytes on the heap, zeroing its contents.
+ * Fault in a run of committed pages, ready for writing, without changing their
+ * contents.  Kernels that predate `MADV_POPULATE_WRITE` get each page touched
+ * instead, with an atomic add of zero lest the page already holds a block.
  *
- * \param nmemb The number of elements in the new block.
- * \param size  The size, in bytes, of each of the `nmemb` elements.
- * \return      A pointer to the newly allocated and zeroed block, if successful;
- *              `NULL` if unsuccessful.
+ * \param start_addr The first page to populate.
+ * \param end_addr   The end of the pages to populate.
  */
-void* calloc (size_t nmemb, size_t size) {
-
-  // Allocate a block of the requested size.
-  size_t block_size = nmemb * size;
-  void*  block_ptr  = malloc(block_size);
+static void populate (intptr_t start_addr, intptr_t end_addr) {
 
-  // If the allocation succeeded, clear the entire block.
-  if (block_ptr != NULL) {
-    memset(block_ptr, 0, block_size);
+  if (madvise((void*)start_addr, end_addr - start_addr, MADV_POPULATE_WRITE) == 0) {
+    return;
+  }
+  for (intptr_t page_addr = start_addr; page_addr < end_addr; page_addr += PAGE_SIZE) {
+    __atomic_fetch_add((char*)page_addr, 0, __ATOMIC_RELAXED);
   }
 
-  return block_ptr;
-  
-} // calloc ()
+} // populate ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+// Defined below, with the rest of the region and statistics functions.
+static bool region_commit (region_s* region, intptr_t needed_addr);
+static void stats_release (void* record);
+#if defined (RECYCLE_ALLOC)
+static void queue_release (void* queue);
+static bool queue_drain ();
+#endif /* RECYCLE_ALLOC */
+static void trace_release (void* trace);
+static void fork_prepare ();
+static void fork_parent ();
+static void fork_child ();
 // ==============================================================================
 
 
 
 // ==============================================================================
 /**
- * Update the given block at `ptr` to take on the given `size`.  Here, if `size`
- * fits within the given block, then the block is returned unchanged.  If the
- * `size` is an increase for the block, then a new and larger block is
- * allocated, and the data from the old block is copied, the old block freed,
- * and the new block returned.
+ * Commit and populate the heap up to a given address.  A thread that finds
+ * another already populating leaves the work to it, rather than wait.
  *
- * \param ptr  The block to be assigned a new size.
- * \param size The new size that the block should assume.
- * \return     A pointer to the resultant block, which may be `ptr` itself, or
- *             may be a newly allocated block.
+ * \param target_addr The address up to which the heap should be populated.
  */
-void* realloc (void* ptr, size_t size) {
+static void heap_populate (intptr_t target_addr) {
 
-  // if there is no given block, then simply return
-  // a new block of given size using malloc()
-  if (ptr == NULL) {
-    return malloc(size);
+  if (target_addr <= __atomic_load_n(&populate_addr, __ATOMIC_RELAXED) ||
+      pthread_mutex_trylock(&prefault_lock) != 0) {
+    return;
   }
 
-  // if the requested size is 0, then free the current block as
-  // it is no longer needed. Return NULL to signify a block of size 0.
-  if (size == 0) {
-    free(ptr);
-    return NULL;
+  target_addr = ALIGN_UP(target_addr, PAGE_SIZE);
+  if (target_addr > heap.end_addr) {
+    target_addr = heap.end_addr;
   }
-  
-  // find the header of the old block by taking the address of the block and
-  // shifting backwards in the address space the number of bytes equivalent to
-  // the size of the header
-  header_s* old_header = (header_s*)((intptr_t)ptr - sizeof(header_s));
-  // with a pointer to the header, store the size of the old block which
-  // is stored in the header
-  size_t    old_size   = old_header->size;
-
-  // if the requested size is less than the old size, then the old block
-  // is sufficient and the old pointer can be returned
-  if (size <= old_size) {
-    return ptr;
+  if (target_addr > populate_addr &&
+      (target_addr <= __atomic_load_n(&heap.commit_addr, __ATOMIC_ACQUIRE) ||
+       region_commit(&heap, target_addr))) {
+    populate(populate_addr, target_addr);
+    __atomic_store_n(&populate_addr, target_addr, __ATOMIC_RELAXED);
   }
-  
-  // if the requested size is more than the size of the old block then a new
-  // block must be allocated. Allocate a new block using malloc()
-  void* new_ptr = malloc(size);
+
+  pthread_mutex_unlock(&prefault_lock);
+
+} // heap_populate ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * With prefaulting enabled, keep the heap populated `PREFAULT_AHEAD` beyond
+ * its bump pointer.  Called on the slow paths that advance that pointer.
+ */
+static void heap_prefault () {
+
+  if (config.prefault_size > 0) {
+    heap_populate(__atomic_load_n(&heap.free_addr, __ATOMIC_RELAXED) + PREFAULT_AHEAD);
+  }
+
+} // heap_prefault ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Read a size from the environment, without allocating.  The value is a
+ * decimal number of bytes, optionally followed by `K`, `M`, or `G`.
+ *
+ * \param name          The name of the environment variable.
+ * \param default_value The size to use if the variable is unset or malformed.
+ * \return              The size given by the variable, or `default_value`.
+ */
+static size_t env_size (const char* name, size_t default_value) {
+
+  const char* value = getenv(name);
+  if (value == NULL || *value < '0' || *value > '9') {
+    return default_value;
+  }
+
+  size_t size = 0;
+  for (; *value >= '0' && *value <= '9'; value += 1) {
+    size = size * 10 + (*value - '0');
+  }
+  switch (*value) {
+  case 'k': case 'K': size = KB(size); value += 1; break;
+  case 'm': case 'M': size = MB(size); value += 1; break;
+  case 'g': case 'G': size = GB(size); value += 1; break;
+  }
+
+  return (*value == '\0') ? size : default_value;
+
+} // env_size ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Read a yes-or-no setting from the environment, without allocating.
+ *
+ * \param name          The name of the environment variable.
+ * \param default_value The setting to use if the variable is unset or
+ *                      malformed.
+ * \return              The setting given by the variable, or `default_value`.
+ */
+static bool env_flag (const char* name, bool default_value) {
+
+  const char* value = getenv(name);
+  if (value == NULL) {
+    return default_value;
+  }
+
+  switch (*value) {
+  case '1': case 'y': case 'Y': case 't': case 'T': return true;
+  case '0': case 'n': case 'N': case 'f': case 'F': return false;
+  case 'o': case 'O':
+    return (value[1] == 'n' || value[1] == 'N') ? true
+      : (value[1] == 'f' || value[1] == 'F') ? false
+      : default_value;
+  default:
+    return default_value;
+  }
+
+} // env_flag ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Count the system's NUMA nodes, without allocating, from the highest number
+ * in the list of possible nodes.
+ *
+ * \return The number of nodes; `1` if they cannot be found.
+ */
+static int numa_node_count () {
+
+  int fd = open("/sys/devices/system/node/possible", O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return 1;
+  }
+  char    list[256];
+  ssize_t length = read(fd, list, sizeof(list) - 1);
+  close(fd);
+  if (length <= 0) {
+    return 1;
+  }
+  list[length] = '\0';
+
+  // The list is of numbers and ranges, in order, such as "0-3" or "0,2".
+  int highest = 0;
+  int number  = 0;
+  for (const char* c = list; ; c += 1) {
+    if (*c >= '0' && *c <= '9') {
+      number = number * 10 + (*c - '0');
+    } else {
+      highest = (number > highest) ? number : highest;
+      number  = 0;
+      if (*c == '\0') {
+	break;
+      }
+    }
+  }
+
+  return (highest + 1 < NUMA_NODES_MAX) ? highest + 1 : NUMA_NODES_MAX;
+
+} // numa_node_count ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Read the allocator's settings from the environment (see the top of this
+ * file), ignoring any that are out of range.
+ */
+static void configure () {
+
+  size_t heap_size = env_size("PB_HEAP_SIZE", HEAP_SIZE);
+  if (heap_size >= COMMIT_MIN && heap_size <= ((size_t)1 << 47)) {
+    config.heap_size = ALIGN_UP(heap_size, HUGE_PAGE);
+  }
+
+  size_t align = env_size("PB_ALIGN", BLOCK_ALIGN);
+  if (align >= BLOCK_ALIGN && align <= (size_t)PAGE_SIZE && (align & (align - 1)) == 0) {
+    config.align = align;
+  }
+
+  size_t tlab_size = env_size("PB_TLAB_SIZE", TLAB_SIZE);
+  if (tlab_size >= TLAB_SIZE_MIN && tlab_size <= TLAB_SIZE_MAX) {
+    config.tlab_size = (size_t)1 << (64 - __builtin_clzll(tlab_size - 1));
+  }
+
+  config.hugepages     = env_flag("PB_HUGEPAGES", config.hugepages);
+  config.prefault_size = env_size("PB_PREFAULT", 0);
+  config.stats         = env_flag("PB_STATS", false);
+
+  config.sample_interval = env_size("PB_SAMPLE_INTERVAL", 0);
+  config.purge_threshold = env_size("PB_PURGE", PURGE_THRESHOLD);
+
+  int nodes = numa_node_count();
+  if (nodes > 1 && env_flag("PB_NUMA", true)) {
+    config.numa_nodes    = nodes;
+    config.prefault_size = 0;
+  }
+
+  const char* trace_prefix = getenv("PB_TRACE");
+  if (trace_prefix != NULL && *trace_prefix != '\0') {
+    config.trace_prefix = trace_prefix;
+  }
+
+#if defined (HARDENED_ALLOC)
+  if (env_flag("PB_GUARD_PAGES", false)) {
+    config.guard_size = PAGE_SIZE;
+  }
+#endif /* HARDENED_ALLOC */
+
+} // configure ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * The initialization method.  If this is the first use of the heap, initialize it.
+ * Safe to call from any number of threads at once:  exactly one of them maps
+ * the heap, and the rest wait until it has been published.
+ */
+
+void init () {
+
+  // Nothing to do once the heap region exists.
+  if (__atomic_load_n(&heap_state, __ATOMIC_ACQUIRE) == HEAP_READY) {
+    return;
+  }
+
+  // Claim the job of initializing.  A thread that loses the race spins until
+  // the winner has published the heap boundaries.
+  int expected = HEAP_UNINITIALIZED;
+  if (!__atomic_compare_exchange_n(&heap_state, &expected, HEAP_INITIALIZING,
+				   false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+    while (__atomic_load_n(&heap_state, __ATOMIC_ACQUIRE) != HEAP_READY) {
+      sched_yield();
+    }
+    return;
+  }
+
+  DEBUG("Trying to initialize");
+  configure();
+
+#if defined (HARDENED_ALLOC)
+  // Draw the canaries' secret before any block needs one.  Without the
+  // kernel's entropy, the clock and the randomized layout have to serve.
+  if (getrandom(&canary_secret, sizeof(canary_secret), GRND_NONBLOCK) != sizeof(canary_secret)) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    canary_secret = ((uint64_t)now.tv_nsec ^ (uint64_t)(intptr_t)&now) * 0x9e3779b97f4a7c15ULL;
+  }
+#endif /* HARDENED_ALLOC */
+
+  // Reserve virtual address space in which the heap will reside. Make it
+  // un-shared and not backed by any file (_anonymous_ space), and inaccessible
+  // and unaccounted until region_commit() opens it up.  A failure to map this
+  // space is fatal.
+  size_t heap_size = config.heap_size;
+  size_t reserve   = heap_size;
+  if (config.hugepages) {
+    // Over-reserve by a huge page, so that an aligned heap fits within.
+    reserve += HUGE_PAGE;
+  }
+  void* mapping = mmap(NULL,
+		    reserve,
+		    PROT_NONE,
+		    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+		    -1,
+		    0);
+  if (mapping == MAP_FAILED) {
+    ERROR("Could not mmap() heap region");
+  }
+
+  if (config.hugepages) {
+    // Trim the reservation to an aligned heap, and ask that the kernel back
+    // it with huge pages.  The advice is only a hint; if transparent huge
+    // pages are disabled, the heap simply keeps its ordinary pages.
+    // (`MAP_HUGETLB` is no use here:  it draws on a pool of pages set aside by
+    // the administrator, and would fault with `SIGBUS`, rather than fail, once
+    // that runs dry.)
+    intptr_t reserve_addr = (intptr_t)mapping;
+    intptr_t aligned_addr = ALIGN_UP(reserve_addr, HUGE_PAGE);
+    if (aligned_addr > reserve_addr) {
+      munmap((void*)reserve_addr, aligned_addr - reserve_addr);
+    }
+    munmap((void*)(aligned_addr + heap_size),
+	   reserve_addr + reserve - (aligned_addr + heap_size));
+    mapping = (void*)aligned_addr;
+    madvise(mapping, heap_size, MADV_HUGEPAGE);
+  }
+
+#if defined (HEADERLESS_ALLOC)
+  // The page class table, like the heap, costs nothing until it is touched.
+  void* table = mmap(NULL,
+		     heap_size / CLASS_PAGE,
+		     PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+		     -1,
+		     0);
+  if (table == MAP_FAILED) {
+    ERROR("Could not mmap() page class table");
+  }
+  page_classes = (uint8_t*)table;
+#endif /* HEADERLESS_ALLOC */
+
+  // Hold onto the boundaries of the heap as a whole.
+  heap.start_addr  = (intptr_t)mapping;
+  heap.end_addr    = heap.start_addr + heap_size;
+  heap.free_addr   = heap.start_addr;
+  heap.commit_addr = heap.start_addr;
+  populate_addr    = heap.start_addr;
+
+  // Divide the heap among the NUMA nodes, each region aligned for huge pages
+  // and chunks, and bind each to its node.  A heap too small to divide is
+  // left whole.
+  if (config.numa_nodes > 1) {
+    size_t unit    = (config.tlab_size > HUGE_PAGE) ? config.tlab_size : HUGE_PAGE;
+    node_heap_size = ALIGN_DOWN(heap_size / config.numa_nodes, unit);
+    if (node_heap_size < 2 * unit) {
+      config.numa_nodes = 0;
+    }
+  }
+  for (int node = 0; node < config.numa_nodes; node += 1) {
+    region_s* region    = &node_heaps[node];
+    region->start_addr  = heap.start_addr + node * node_heap_size;
+    region->end_addr    = region->start_addr + node_heap_size;
+    region->free_addr   = region->start_addr;
+    region->commit_addr = region->start_addr;
+    unsigned long nodemask[NUMA_NODES_MAX / (8 * sizeof(unsigned long))] = { 0 };
+    nodemask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+    syscall(SYS_mbind, region->start_addr, node_heap_size, MPOL_PREFERRED,
+	    nodemask, NUMA_NODES_MAX, 0);
+  }
+
+  // Populate however much of the heap was asked for, before any thread can
+  // use it.
+  if (config.prefault_size > 0) {
+    heap_populate(heap.start_addr + config.prefault_size);
+  }
+
+#if defined (CHUNK_PURGE)
+  // The chunk table, like the heap, costs nothing until it is touched.
+  if (config.purge_threshold > 0) {
+    chunk_shift = __builtin_ctzll(config.tlab_size);
+    void* chunk_table = mmap(NULL,
+			     ((heap_size >> chunk_shift) + 1) * sizeof(chunk_s),
+			     PROT_READ | PROT_WRITE,
+			     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+			     -1,
+			     0);
+    chunks = (chunk_table == MAP_FAILED) ? NULL : (chunk_s*)chunk_table;
+  }
+#endif /* CHUNK_PURGE */
+
+#if defined (RECYCLE_ALLOC)
+  // So is the table of chunk owners, through which other threads return the
+  // blocks that they free.
+  chunk_shift = __builtin_ctzll(config.tlab_size);
+  void* owner_table = mmap(NULL,
+			   ((heap_size >> chunk_shift) + 1) * sizeof(remote_queue_s*),
+			   PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+			   -1,
+			   0);
+  chunk_owners = (owner_table == MAP_FAILED) ? NULL : (remote_queue_s**)owner_table;
+
+  // Let exiting threads hand their remote-free queues on.
+  pthread_key_create(&queue_key, queue_release);
+#endif /* RECYCLE_ALLOC */
+
+  // Let exiting threads hand their statistics records on.
+  pthread_key_create(&stats_key, stats_release);
+
+  // Let exiting threads close their traces.
+  if (config.trace_prefix != NULL) {
+    pthread_key_create(&trace_key, trace_release);
+  }
+
+  // Make room for the profiler's samples, if it is enabled.  Like the heap,
+  // the ring costs nothing until it is written.
+  if (config.sample_interval > 0) {
+    void* ring = mmap(NULL,
+		      SAMPLE_RING * sizeof(sample_s),
+		      PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+		      -1,
+		      0);
+    samples = (ring == MAP_FAILED) ? NULL : (sample_s*)ring;
+  }
+
+  // Publish the boundaries to every other thread.
+  __atomic_store_n(&heap_state, HEAP_READY, __ATOMIC_RELEASE);
+
+  // DEBUG: Emit a message to indicate that this allocator is being called.
+  DEBUG("bp-alloc initialized");
+
+} // init ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Initialize the heap if that has not been done yet.  Once the heap exists,
+ * this is a single, predicted branch, inlined into the caller; it never goes
+ * through `init()`'s entry in the procedure linkage table.
+ */
+static inline void ensure_init () {
+
+  if (__builtin_expect(__atomic_load_n(&heap_state, __ATOMIC_ACQUIRE) != HEAP_READY, false)) {
+    init();
+  }
+
+} // ensure_init ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Initialize the heap when the library is loaded, so that, usually, no
+ * allocation has to.  Anything that allocates before this runs (another
+ * library's constructor, say) still initializes the heap itself.  The fork
+ * handlers are registered here, rather than in `init()`, since
+ * `pthread_atfork()` may allocate.
+ */
+__attribute__ ((constructor))
+static void init_at_load () {
+
+  init();
+  pthread_atfork(fork_prepare, fork_parent, fork_child);
+
+} // init_at_load ()
+// ==============================================================================
+
+
+#if defined (RECYCLE_ALLOC) || defined (HEADERLESS_ALLOC)
+// ==============================================================================
+/**
+ * Find the size class for a block.
+ *
+ * \param size The number of bytes needed; at least 1 and at most
+ *             `CLASS_MAX`.
+ * \return     The index of the smallest class that holds `size` bytes.
+ */
+static int size_class (size_t size) {
+
+  // Small sizes are evenly spaced; the rest are the powers of two above
+  // SMALL_CLASS_MAX.
+  if (size <= SMALL_CLASS_MAX) {
+    return (size - 1) / CLASS_SPACING;
+  }
+  int log2_size = 64 - __builtin_clzll(size - 1);
+  return SMALL_CLASSES + log2_size - (__builtin_ctzll(SMALL_CLASS_MAX) + 1);
+
+} // size_class ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Find the number of bytes in blocks of a given size class.
+ *
+ * \param class The index of the size class.
+ * \return      The size of every block in that class.
+ */
+static size_t class_size (int class) {
+
+  if (class < SMALL_CLASSES) {
+    return (size_t)(class + 1) * CLASS_SPACING;
+  }
+  return SMALL_CLASS_MAX << (class - SMALL_CLASSES + 1);
+
+} // class_size ()
+// ==============================================================================
+#endif /* RECYCLE_ALLOC || HEADERLESS_ALLOC */
+
+
+
+// ==============================================================================
+/**
+ * Grow the committed part of a region so that it reaches at least a given
+ * address.  This is the slow path of `region_reserve()`, so it takes a lock;
+ * whichever thread gets there first commits enough for the others too.
+ *
+ * \param region      The region to grow.
+ * \param needed_addr The address up to which the region must be usable.
+ * \return            `true` if successful; `false` if the system refused.
+ */
+static bool region_commit (region_s* region, intptr_t needed_addr) {
+
+  pthread_mutex_lock(&heap_lock);
+
+  bool     success    = true;
+  intptr_t old_commit = region->commit_addr;
+  if (needed_addr > old_commit) {
+
+    // Grow by at least as much as is already committed, within the limits.
+    size_t increment = old_commit - region->start_addr;
+    if (increment < COMMIT_MIN) {
+      increment = COMMIT_MIN;
+    } else if (increment > COMMIT_MAX) {
+      increment = COMMIT_MAX;
+    }
+    intptr_t new_commit = ALIGN_UP(needed_addr, COMMIT_MIN);
+    if (new_commit < old_commit + (intptr_t)increment) {
+      new_commit = old_commit + increment;
+    }
+    if (new_commit > region->end_addr) {
+      new_commit = region->end_addr;
+    }
+
+    if (mprotect((void*)old_commit, new_commit - old_commit, PROT_READ | PROT_WRITE) == 0) {
+      __atomic_store_n(&region->commit_addr, new_commit, __ATOMIC_RELEASE);
+    } else {
+      success = false;
+    }
+
+  }
+
+  pthread_mutex_unlock(&heap_lock);
+  return success;
+
+} // region_commit ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Reserve space from a shared region:  `lead` bytes followed by `size` bytes
+ * that begin at an `align` boundary.  The space is claimed by a
+ * compare-and-swap on `free_addr`, so that concurrent callers can never be
+ * handed overlapping space.  If another thread moves `free_addr` first, the
+ * layout is recomputed from the new value and the swap retried.  Space beyond
+ * the committed part of the region is committed before it is returned.
+ *
+ * \param region     The region from which to reserve.
+ * \param lead       The number of bytes needed before the aligned space.
+ * \param size       The number of bytes needed from the aligned address onward.
+ * \param align      The alignment of the space; a power of 2.
+ * \param start_addr Where to store the address at which the reserved space
+ *                   begins, padding included; may be `NULL`.
+ * \return           The aligned address, if successful; `0` if the region is
+ *                   full.
+ */
+static intptr_t region_reserve (region_s* region, size_t lead, size_t size, size_t align,
+				intptr_t* start_addr) {
+
+  intptr_t old_free_addr = __atomic_load_n(&region->free_addr, __ATOMIC_RELAXED);
+  intptr_t block_addr;
+  intptr_t new_free_addr;
+  do {
+
+    block_addr = ALIGN_UP(old_free_addr + (intptr_t)lead, align);
+
+    // if the space would run beyond the end of the region, fail
+    if (block_addr > region->end_addr || size > (size_t)(region->end_addr - block_addr)) {
+      return 0;
+    }
+    new_free_addr = block_addr + size;
+
+  } while (!__atomic_compare_exchange_n(&region->free_addr, &old_free_addr, new_free_addr,
+					true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+
+  // Sequentially consistent, against region_trim(), which lowers commit_addr
+  // before it reads free_addr:  either it sees this reservation, or this
+  // sees the lowered commit_addr and recommits.
+  if (new_free_addr > __atomic_load_n(&region->commit_addr, __ATOMIC_SEQ_CST) &&
+      !region_commit(region, new_free_addr)) {
+    return 0;
+  }
+
+  if (start_addr != NULL) {
+    *start_addr = old_free_addr;
+  }
+  return block_addr;
+
+} // region_reserve ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Extend the last block reserved from a shared region, if a given block is
+ * still that block:  move `free_addr` from the block's end to its new end.
+ *
+ * \param region  The region that holds the block.
+ * \param old_end The current end of the block.
+ * \param new_end The end that the block should have.
+ * \return        `true` if the block was extended; `false` if another block
+ *                follows it or the region is full.
+ */
+static bool region_extend (region_s* region, intptr_t old_end, intptr_t new_end) {
+
+  if (new_end > region->end_addr ||
+      !__atomic_compare_exchange_n(&region->free_addr, &old_end, new_end,
+				   false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+    return false;
+  }
+
+  return (new_end <= __atomic_load_n(&region->commit_addr, __ATOMIC_SEQ_CST) ||
+	  region_commit(region, new_end));
+
+} // region_extend ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Reserve space from the heap, as `region_reserve()` does.  With the heap
+ * divided by NUMA node, the space comes from the calling thread's node, or,
+ * if that region is full, from the others in turn.
+ *
+ * \param lead       The number of bytes needed before the aligned space.
+ * \param size       The number of bytes needed from the aligned address onward.
+ * \param align      The alignment of the space; a power of 2.
+ * \param start_addr Where to store the address at which the reserved space
+ *                   begins, padding included; may be `NULL`.
+ * \return           The aligned address, if successful; `0` if the heap is
+ *                   full.
+ */
+static intptr_t heap_reserve (size_t lead, size_t size, size_t align, intptr_t* start_addr) {
+
+  if (config.numa_nodes == 0) {
+    return region_reserve(&heap, lead, size, align, start_addr);
+  }
+
+  for (int i = 0; i < config.numa_nodes; i += 1) {
+    region_s* region = &node_heaps[(thread_node + i) % config.numa_nodes];
+    intptr_t  addr   = region_reserve(region, lead, size, align, start_addr);
+    if (addr != 0) {
+      return addr;
+    }
+  }
+  return 0;
+
+} // heap_reserve ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Find the region of the heap that holds an address in it.
+ *
+ * \param addr The address.
+ * \return     The heap itself, or the region of the node that holds `addr`.
+ */
+static region_s* heap_region_of (intptr_t addr) {
+
+  return (config.numa_nodes == 0)
+    ? &heap
+    : &node_heaps[(addr - heap.start_addr) / node_heap_size];
+
+} // heap_region_of ()
+// ==============================================================================
+
+
+
+#if defined (RECYCLE_ALLOC)
+// ==============================================================================
+/**
+ * Find the entry of the chunk-owner table for the chunk that holds an address
+ * of the heap.
+ *
+ * \param addr The address.
+ * \return     Where the owner's queue is recorded.
+ */
+static inline remote_queue_s** owner_slot (intptr_t addr) {
+
+  return &chunk_owners[(addr >> chunk_shift) - (heap.start_addr >> chunk_shift)];
+
+} // owner_slot ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Give the calling thread a remote-free queue:  one left by an exited thread,
+ * if there is one, along with whatever has been pushed onto it since, or else
+ * a new one carved from the heap.
+ *
+ * \return The thread's queue, if successful; `NULL` if the heap is full.
+ */
+static remote_queue_s* queue_register () {
+
+  remote_queue_s* queue;
+  for (queue = __atomic_load_n(&all_queues, __ATOMIC_ACQUIRE);
+       queue != NULL;
+       queue = queue->next) {
+    int expected = false;
+    if (__atomic_compare_exchange_n(&queue->in_use, &expected, true,
+				    false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      break;
+    }
+  }
+
+  // Fresh heap space is zero, so a new queue starts empty.
+  if (queue == NULL) {
+    queue = (remote_queue_s*)heap_reserve(0, sizeof(remote_queue_s), 64, NULL);
+    if (queue == NULL) {
+      return NULL;
+    }
+    queue->in_use = true;
+    queue->next   = __atomic_load_n(&all_queues, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&all_queues, &queue->next, queue,
+					true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  }
+
+  queue->free_lists = free_lists;
+  my_queue          = queue;
+  pthread_setspecific(queue_key, queue);
+  return queue;
+
+} // queue_register ()
+// ==============================================================================
+#endif /* RECYCLE_ALLOC */
+
+
+
+#if defined (CHUNK_PURGE)
+// ==============================================================================
+/**
+ * Find the state of the chunk that holds an address of the heap.  Chunks are
+ * aligned to their size in the address space, not relative to the heap,
+ * which may start anywhere.
+ *
+ * \param addr The address.
+ * \return     The chunk's entry in the chunk table.
+ */
+static inline chunk_s* chunk_at (intptr_t addr) {
+
+  return &chunks[(addr >> chunk_shift) - (heap.start_addr >> chunk_shift)];
+
+} // chunk_at ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Release the pages of a dead chunk, unless another thread already has.  No
+ * block will ever be bumped from the chunk again, so its pages can simply
+ * be dropped.
+ *
+ * \param chunk The chunk's entry in the chunk table.
+ */
+static void chunk_purge (chunk_s* chunk) {
+
+  int expected = CHUNK_SEALED;
+  if (__atomic_compare_exchange_n(&chunk->state, &expected, CHUNK_PURGED,
+				  false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    intptr_t chunk_addr = ((heap.start_addr >> chunk_shift) + (chunk - chunks)) << chunk_shift;
+    madvise((void*)chunk_addr, config.tlab_size, MADV_DONTNEED);
+    __atomic_add_fetch(&bytes_purged, config.tlab_size, __ATOMIC_RELAXED);
+  }
+
+} // chunk_purge ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Seal a thread's chunk, which it is done with, by publishing the number of
+ * blocks bumped from it; if they have all been freed already, release its
+ * pages.  The thread is left without a chunk.
+ *
+ * \param owner  The thread's chunk; usually the calling thread's own.
+ * \param allocs The number of blocks bumped from the chunk.
+ */
+static void chunk_seal (tlab_s* owner, size_t allocs) {
+
+  if (chunks != NULL && owner->end_addr != 0) {
+    chunk_s* chunk = chunk_at(owner->end_addr - 1);
+    __atomic_store_n(&chunk->total, allocs,       __ATOMIC_SEQ_CST);
+    __atomic_store_n(&chunk->state, CHUNK_SEALED, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&chunk->frees, __ATOMIC_SEQ_CST) == allocs) {
+      chunk_purge(chunk);
+    }
+  }
+  owner->free_addr = 0;
+  owner->end_addr  = 0;
+
+} // chunk_seal ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Count a freed block against its chunk, if it was bumped from one; if that
+ * was the last of a sealed chunk's blocks, release the chunk's pages.
+ *
+ * \param ptr The freed block, which is in the heap.
+ */
+static void chunk_free (void* ptr) {
+
+  if (chunks == NULL) {
+    return;
+  }
+  chunk_s* chunk = chunk_at((intptr_t)ptr);
+  if (__atomic_load_n(&chunk->state, __ATOMIC_RELAXED) == CHUNK_NONE) {
+    return;
+  }
+
+  size_t frees = __atomic_add_fetch(&chunk->frees, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&chunk->state, __ATOMIC_SEQ_CST) == CHUNK_SEALED &&
+      frees == __atomic_load_n(&chunk->total, __ATOMIC_RELAXED)) {
+    chunk_purge(chunk);
+  }
+
+} // chunk_free ()
+// ==============================================================================
+#endif /* CHUNK_PURGE */
+
+
+
+// ==============================================================================
+/**
+ * Replace the calling thread's chunk with a fresh one from the shared heap.
+ * Whatever was left of the old chunk is abandoned.  When dead chunks are
+ * purged, each chunk is aligned to its size, so that the chunk table can find
+ * it from any block within.
+ *
+ * \return `true` if a new chunk was obtained; `false` if the heap is full.
+ */
+static bool tlab_refill () {
+
+  size_t align = BLOCK_ALIGN;
+#if defined (CHUNK_PURGE)
+  chunk_seal(&tlab, tlab_allocs);
+  if (chunks != NULL) {
+    align = config.tlab_size;
+  }
+#endif /* CHUNK_PURGE */
+
+#if defined (RECYCLE_ALLOC)
+  // Other threads find the owner of a block through its chunk, so chunks must
+  // be aligned, and the thread needs a queue on which to take their frees.
+  if (chunk_owners != NULL) {
+    align = config.tlab_size;
+    if (my_queue == NULL && queue_register() == NULL) {
+      return false;
+    }
+  }
+#endif /* RECYCLE_ALLOC */
+
+  // A thread may have moved since its last chunk, so look up its node afresh.
+  if (config.numa_nodes > 0) {
+    unsigned int node;
+    if (getcpu(NULL, &node) == 0 && node < (unsigned int)config.numa_nodes) {
+      thread_node = node;
+    }
+  }
+
+  intptr_t chunk_addr = heap_reserve(0, config.tlab_size, align, NULL);
+  if (chunk_addr == 0) {
+    return false;
+  }
+
+#if defined (CHUNK_PURGE)
+  if (chunks != NULL) {
+    tlab_allocs = 0;
+    __atomic_store_n(&chunk_at(chunk_addr)->state, CHUNK_OPEN, __ATOMIC_RELAXED);
+  }
+#endif /* CHUNK_PURGE */
+
+#if defined (RECYCLE_ALLOC)
+  if (chunk_owners != NULL) {
+    __atomic_store_n(owner_slot(chunk_addr), my_queue, __ATOMIC_RELAXED);
+  }
+#endif /* RECYCLE_ALLOC */
+
+  tlab.free_addr = chunk_addr;
+  tlab.end_addr  = chunk_addr + config.tlab_size;
+  heap_prefault();
+  return true;
+
+} // tlab_refill ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Give the calling thread a statistics record:  one left by an exited thread,
+ * if there is one, or else a new one carved from the heap.
+ *
+ * \return The thread's record.
+ */
+static thread_stats_s* stats_register () {
+
+  init();
+
+  thread_stats_s* record;
+  for (record = __atomic_load_n(&all_stats, __ATOMIC_ACQUIRE);
+       record != NULL;
+       record = record->next) {
+    int expected = false;
+    if (__atomic_compare_exchange_n(&record->in_use, &expected, true,
+				    false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      break;
+    }
+  }
+
+  // Fresh heap space is zero, so a new record starts with no counts.
+  if (record == NULL) {
+    record = (thread_stats_s*)heap_reserve(0, sizeof(thread_stats_s), 64, NULL);
+    if (record == NULL) {
+      return &orphan_stats;
+    }
+    record->in_use = true;
+    record->next   = __atomic_load_n(&all_stats, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&all_stats, &record->next, record,
+					true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  }
+
+#if defined (CHUNK_PURGE)
+  record->tlab        = &tlab;
+  record->tlab_allocs = &tlab_allocs;
+#endif /* CHUNK_PURGE */
+  thread_stats = record;
+  pthread_setspecific(stats_key, record);
+  return record;
+
+} // stats_register ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Hand an exiting thread's statistics record on to the next new thread.  Any
+ * counting that the thread does later in its exit goes to `orphan_stats`.
+ * The thread's chunk is sealed too, so that it can be purged once its blocks
+ * have been freed.
+ *
+ * \param record The thread's record.
+ */
+static void stats_release (void* record) {
+
+#if defined (CHUNK_PURGE)
+  chunk_seal(&tlab, tlab_allocs);
+#endif /* CHUNK_PURGE */
+  thread_stats = &orphan_stats;
+  __atomic_store_n(&((thread_stats_s*)record)->in_use, false, __ATOMIC_RELEASE);
+
+} // stats_release ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Find the calling thread's statistics record, registering one on first use.
+ */
+static inline thread_stats_s* my_stats () {
+
+  thread_stats_s* record = thread_stats;
+  if (__builtin_expect(record == NULL, false)) {
+    record = stats_register();
+  }
+  return record;
+
+} // my_stats ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Approximate a base-2 logarithm, without the maths library:  the exponent of
+ * `x`, plus a polynomial fit of the logarithm of its mantissa.  Accurate to
+ * within about 0.005, which is plenty for drawing sampling distances.
+ *
+ * \param x A positive number.
+ * \return  Approximately `log2(x)`.
+ */
+static double fast_log2 (double x) {
+
+  union { double value; uint64_t bits; } number = { .value = x };
+  int exponent = (int)((number.bits >> 52) & 0x7ff) - 1023;
+  number.bits  = (number.bits & (((uint64_t)1 << 52) - 1)) | ((uint64_t)1023 << 52);
+
+  double m = number.value;
+  return exponent + (-1.7417939 + (2.8212026 + (-1.4699568 + (0.44717955 - 0.056570851 * m) * m) * m) * m);
+
+} // fast_log2 ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Draw the number of bytes until the calling thread's next sample.  The
+ * distances are exponentially distributed with a mean of the sampling
+ * interval, so that every byte allocated is equally likely to be sampled.
+ *
+ * \return The distance to the next sample; at least 1.
+ */
+static intptr_t sample_distance () {
+
+  // xorshift64*
+  sample_random ^= sample_random >> 12;
+  sample_random ^= sample_random << 25;
+  sample_random ^= sample_random >> 27;
+  uint64_t random = sample_random * 0x2545f4914f6cdd1dULL;
+
+  // A uniform variate in (0, 1], transformed by the inverse of the
+  // exponential distribution's CDF.
+  double uniform  = (double)((random >> 11) + 1) * 0x1.0p-53;
+  double distance = -fast_log2(uniform) * 0.6931471805599453 * (double)config.sample_interval;
+  return (distance < 1.0) ? 1 : (distance > (double)INTPTR_MAX / 2) ? INTPTR_MAX / 2 : (intptr_t)distance;
+
+} // sample_distance ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * The slow path of sampling:  record the stack trace of the request that the
+ * calling thread's distance ran out on, and draw the next distance.  With
+ * profiling disabled, the distance is set so far off that it never runs out.
+ * Allocations made by `backtrace()` itself (it loads its unwinder on first
+ * use) are counted but never sampled.
+ *
+ * \param size The number of bytes requested.
+ */
+__attribute__ ((noinline))
+static void sample (size_t size) {
+
+  if (samples == NULL) {
+    bytes_until_sample = INTPTR_MAX;
+    return;
+  }
+
+  // A thread's first request only starts its count.
+  if (sample_random == 0) {
+    sample_random      = ((uint64_t)(intptr_t)&sample_random * 0x9e3779b97f4a7c15ULL) | 1;
+    bytes_until_sample = sample_distance();
+    return;
+  }
+  bytes_until_sample = sample_distance();
+  if (sampling) {
+    return;
+  }
+  sampling = true;
+
+  // Claim the next slot of the ring, and mark it as being written.
+  size_t    number = __atomic_fetch_add(&sample_count, 1, __ATOMIC_RELAXED);
+  sample_s* slot   = &samples[number & (SAMPLE_RING - 1)];
+  __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  // Skip this function's own frame.
+  void* frames[SAMPLE_DEPTH + 1];
+  int   depth = backtrace(frames, SAMPLE_DEPTH + 1) - 1;
+  slot->size  = size;
+  slot->depth = (depth < 0) ? 0 : depth;
+  memcpy(slot->frames, frames + 1, slot->depth * sizeof(void*));
+
+  __atomic_store_n(&slot->seq, number + 1, __ATOMIC_RELEASE);
+  sampling = false;
+
+} // sample ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Count the bytes of a request (or of a batch of requests of one size), file
+ * it in the histogram of sizes, and, if the calling thread's sampling
+ * distance runs out, sample it.  A batch is sampled at most once.
+ *
+ * \param size  The number of bytes requested.
+ * \param count The number of requests.
+ */
+static inline void count_request (size_t size, size_t count) {
+
+  int bucket = (size <= 1) ? 0 : 64 - __builtin_clzll(size - 1);
+  if (bucket >= PB_SIZE_BUCKETS) {
+    bucket = PB_SIZE_BUCKETS - 1;
+  }
+  thread_stats_s* counts = my_stats();
+  COUNT_TO(counts, bytes_requested,        size * count);
+  COUNT_TO(counts, size_histogram[bucket], count);
+
+  bytes_until_sample -= (intptr_t)(size * count);
+  if (__builtin_expect(bytes_until_sample < 0, false)) {
+    sample(size);
+  }
+
+} // count_request ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Read a timestamp for a trace record:  the processor's timestamp counter,
+ * where there is one, or else the monotonic clock, in nanoseconds.
+ *
+ * \return The current time.
+ */
+static inline uint64_t trace_timestamp () {
+
+#if defined (__x86_64__) || defined (__i386__)
+  return __rdtsc();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+
+} // trace_timestamp ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Append a number, in decimal, to a string being built in a buffer.
+ *
+ * \param dest  Where in the buffer to append the number.
+ * \param limit The end of the buffer.
+ * \param value The number to append.
+ * \return      The end of the string, which is then terminated; `NULL` if the
+ *              number does not fit.
+ */
+static char* append_decimal (char* dest, char* limit, uint64_t value) {
+
+  char  digits[24];
+  char* digit = &digits[sizeof(digits)];
+  do {
+    *--digit = '0' + value % 10;
+    value   /= 10;
+  } while (value != 0);
+
+  size_t length = &digits[sizeof(digits)] - digit;
+  if (length >= (size_t)(limit - dest)) {
+    return NULL;
+  }
+  memcpy(dest, digit, length);
+  dest[length] = '\0';
+  return dest + length;
+
+} // append_decimal ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Open the calling thread's trace file, `<prefix>.<pid>.<n>`, and write its
+ * header.
+ *
+ * \return `true` if successful; `false` if the file could not be created.
+ */
+static bool trace_open () {
+
+  char     path[4096];
+  char*    limit  = &path[sizeof(path)];
+  size_t   length = strlen(config.trace_prefix);
+  uint32_t thread = __atomic_add_fetch(&trace_threads, 1, __ATOMIC_RELAXED);
+  if (length + 2 >= sizeof(path)) {
+    return false;
+  }
+  memcpy(path, config.trace_prefix, length);
+  char* end = path + length;
+  *end++ = '.';
+  end = append_decimal(end, limit, getpid());
+  if (end == NULL || end + 1 >= limit) {
+    return false;
+  }
+  *end++ = '.';
+  if (append_decimal(end, limit, thread) == NULL) {
+    return false;
+  }
+
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  pb_trace_header_t header = { .record_size = sizeof(pb_trace_record_t), .thread = thread };
+  memcpy(header.magic, PB_TRACE_MAGIC, sizeof(header.magic));
+  if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+    close(fd);
+    return false;
+  }
+
+  trace_state.fd = fd;
+  pthread_setspecific(trace_key, &trace_state);
+  return true;
+
+} // trace_open ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * The slow path of tracing:  open the calling thread's trace, on its first
+ * call, or else move its window on to the end of the records written so far,
+ * extending the file to hold the new window.  The file is only ever zeroed
+ * beyond the records, which so end with a record of `PB_TRACE_NONE`.
+ *
+ * \return Where to write the next record; `NULL` if the thread cannot trace.
+ */
+__attribute__ ((noinline))
+static pb_trace_record_t* trace_advance () {
+
+  if (trace_state.done) {
+    return NULL;
+  }
+
+  off_t offset;
+  if (trace_state.window == NULL) {
+    if (!trace_open()) {
+      trace_state.done = true;
+      return NULL;
+    }
+    offset = sizeof(pb_trace_header_t);
+  } else {
+    offset = trace_state.window_offset + ((char*)trace_state.next - trace_state.window);
+    munmap(trace_state.window, TRACE_WINDOW);
+  }
+
+  off_t window_offset = ALIGN_DOWN(offset, PAGE_SIZE);
+  void* window        = MAP_FAILED;
+  if (ftruncate(trace_state.fd, window_offset + TRACE_WINDOW) == 0) {
+    window = mmap(NULL,
+		  TRACE_WINDOW,
+		  PROT_READ | PROT_WRITE,
+		  MAP_SHARED,
+		  trace_state.fd,
+		  window_offset);
+  }
+  if (window == MAP_FAILED) {
+    close(trace_state.fd);
+    trace_state.window = NULL;
+    trace_state.done   = true;
+    return NULL;
+  }
+
+  trace_state.window_offset = window_offset;
+  trace_state.window        = (char*)window;
+  trace_state.end           = trace_state.window + TRACE_WINDOW;
+  trace_state.next          = (pb_trace_record_t*)(trace_state.window + (offset - window_offset));
+  return trace_state.next;
+
+} // trace_advance ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Close an exiting thread's trace.  Whatever the thread calls later in its
+ * exit goes unrecorded.
+ *
+ * \param trace The thread's trace.
+ */
+static void trace_release (void* trace) {
+
+  trace_s* state = (trace_s*)trace;
+  if (state->window != NULL) {
+    munmap(state->window, TRACE_WINDOW);
+    close(state->fd);
+    state->window = NULL;
+  }
+  state->done = true;
+
+} // trace_release ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * If tracing, append a record of a call to the calling thread's trace.
+ *
+ * \param op      The `PB_TRACE_` operation.
+ * \param size    The number of bytes requested.
+ * \param ptr     The block returned, or, for `free()`, the block freed.
+ * \param old_ptr For `realloc()`, the block passed in.
+ * \param align   For the aligned allocators, the alignment requested.
+ */
+static inline void trace (uint32_t op, size_t size, void* ptr, void* old_ptr, size_t align) {
+
+  if (__builtin_expect(config.trace_prefix == NULL, true)) {
+    return;
+  }
+
+  pb_trace_record_t* record = trace_state.next;
+  if (record == NULL || (char*)(record + 1) > trace_state.end) {
+    record = trace_advance();
+    if (record == NULL) {
+      return;
+    }
+  }
+
+  record->tsc     = trace_timestamp();
+  record->size    = size;
+  record->ptr     = (uint64_t)(intptr_t)ptr;
+  record->old_ptr = (uint64_t)(intptr_t)old_ptr;
+  record->align   = align;
+  record->op      = op;
+  trace_state.next = record + 1;
+
+} // trace ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Determine whether a block was bumped from the heap, rather than given a
+ * mapping of its own.
+ */
+static bool in_heap (void* ptr) {
+  return (intptr_t)ptr >= heap.start_addr && (intptr_t)ptr < heap.end_addr;
+}
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Write a block's canaries:  in its header, and in the word after its usable
+ * bytes.  Does nothing unless compiled with `HARDENED_ALLOC`.
+ *
+ * \param ptr  A pointer to the block.
+ * \param size The block's usable size, as recorded in its header.
+ */
+static inline void canary_set (void* ptr, size_t size) {
+
+#if defined (HARDENED_ALLOC)
+  uint64_t canary = canary_secret ^ (uint64_t)(intptr_t)ptr;
+  ((header_s*)ptr)[-1].canary = canary;
+  memcpy((char*)ptr + size, &canary, sizeof(canary));
+#endif /* HARDENED_ALLOC */
+
+} // canary_set ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Check a block's canaries, and abort if either has been overwritten:  by an
+ * overrun of the block before it, or of the block itself.  Does nothing unless
+ * compiled with `HARDENED_ALLOC`.
+ *
+ * \param ptr A pointer to the block.
+ */
+static inline void canary_check (void* ptr) {
+
+#if defined (HARDENED_ALLOC)
+  uint64_t  canary = canary_secret ^ (uint64_t)(intptr_t)ptr;
+  header_s* header = (header_s*)ptr - 1;
+  if (__builtin_expect(header->canary != canary, false)) {
+    FATAL("Block header overwritten: ", (intptr_t)ptr);
+  }
+  uint64_t trailer;
+  memcpy(&trailer, (char*)ptr + header->size, sizeof(trailer));
+  if (__builtin_expect(trailer != canary, false)) {
+    FATAL("Block overrun: ", (intptr_t)ptr, header->size);
+  }
+#endif /* HARDENED_ALLOC */
+
+} // canary_check ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Find the start of the mapping that holds a large block.  The block's header
+ * is always in the mapping's first page.
+ */
+static intptr_t mapping_start (void* ptr) {
+  return ALIGN_DOWN((intptr_t)ptr - (intptr_t)sizeof(header_s), PAGE_SIZE);
+}
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate a large block in a mapping of its own.  The block's usable size is
+ * everything from its aligned start to the end of the mapping.  For
+ * alignments beyond a page, the mapping is made larger than needed and then
+ * trimmed at both ends.
+ *
+ * \param size  The number of bytes to allocate.
+ * \param align The alignment of the block; a power of 2, and at least
+ *              `BLOCK_ALIGN`.
+ * \return      A pointer to the block, if successful; `NULL` if unsuccessful.
+ */
+static void* mapped_malloc (size_t size, size_t align) {
+
+  if (size > HEAP_SIZE || align > HEAP_SIZE) {
+    return NULL;
+  }
+
+  intptr_t offset = ALIGN_UP((intptr_t)sizeof(header_s), align);
+  size_t   slack  = (align > (size_t)PAGE_SIZE) ? align : 0;
+  size_t   length = ALIGN_UP(offset + size + TRAILER_SIZE, PAGE_SIZE) + slack + config.guard_size;
+  void*    mapping = mmap(NULL,
+			  length,
+			  PROT_READ | PROT_WRITE,
+			  MAP_PRIVATE | MAP_ANONYMOUS,
+			  -1,
+			  0);
+  if (mapping == MAP_FAILED) {
+    return NULL;
+  }
+
+  // Return whatever lies outside the pages that the block, its header and
+  // trailer, and its guard need.
+  intptr_t block_addr = ALIGN_UP((intptr_t)mapping + (intptr_t)sizeof(header_s), align);
+  intptr_t start      = mapping_start((void*)block_addr);
+  intptr_t end        = ALIGN_UP(block_addr + (intptr_t)(size + TRAILER_SIZE), PAGE_SIZE);
+  intptr_t guard_end  = end + (intptr_t)config.guard_size;
+  if (start > (intptr_t)mapping) {
+    munmap(mapping, start - (intptr_t)mapping);
+  }
+  if (guard_end < (intptr_t)mapping + (intptr_t)length) {
+    munmap((void*)guard_end, (intptr_t)mapping + length - guard_end);
+  }
+  if (config.guard_size > 0) {
+    mprotect((void*)end, config.guard_size, PROT_NONE);
+  }
+
+  ((header_s*)(block_addr - sizeof(header_s)))->size = end - block_addr - TRAILER_SIZE;
+  canary_set((void*)block_addr, end - block_addr - TRAILER_SIZE);
+  __atomic_add_fetch(&mapped_blocks, 1,           __ATOMIC_RELAXED);
+  __atomic_add_fetch(&mapped_bytes,  end - start, __ATOMIC_RELAXED);
+  COUNT(bytes_consumed, end - start);
+  COUNT(bytes_header,   sizeof(header_s) + TRAILER_SIZE);
+  COUNT(bytes_padding,  block_addr - (intptr_t)sizeof(header_s) - start);
+  COUNT(bytes_rounding, end - block_addr - TRAILER_SIZE - size);
+  return (void*)block_addr;
+
+} // mapped_malloc ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Resize a large block by remapping its pages, which the kernel may move
+ * without copying them.
+ *
+ * \param ptr  A pointer to the block.
+ * \param size The size that the block should have.
+ * \return     A pointer to the resized block, if successful; `NULL` if
+ *             unsuccessful, in which case the block is unchanged.
+ */
+static void* mapped_realloc (void* ptr, size_t size) {
+
+  header_s* header     = (header_s*)((intptr_t)ptr - sizeof(header_s));
+  intptr_t  old_start  = mapping_start(ptr);
+  intptr_t  offset     = (intptr_t)ptr - old_start;
+  size_t    old_length = offset + header->size + TRAILER_SIZE;
+  size_t    guard      = config.guard_size;
+  if (size > HEAP_SIZE) {
+    return NULL;
+  }
+
+  // The guard moves with the block:  opened for the remapping, so that the
+  // whole mapping is one piece, and closed again at the new end.
+  if (guard > 0) {
+    mprotect((void*)(old_start + old_length), guard, PROT_READ | PROT_WRITE);
+  }
+  size_t length  = ALIGN_UP(offset + size + TRAILER_SIZE, PAGE_SIZE);
+  void*  mapping = mremap((void*)old_start, old_length + guard, length + guard, MREMAP_MAYMOVE);
+  if (guard > 0) {
+    intptr_t guard_addr = (mapping == MAP_FAILED) ? old_start + old_length : (intptr_t)mapping + length;
+    mprotect((void*)guard_addr, guard, PROT_NONE);
+  }
+  if (mapping == MAP_FAILED) {
+    return NULL;
+  }
+
+  intptr_t block_addr = (intptr_t)mapping + offset;
+  ((header_s*)(block_addr - sizeof(header_s)))->size = length - offset - TRAILER_SIZE;
+  canary_set((void*)block_addr, length - offset - TRAILER_SIZE);
+  __atomic_add_fetch(&mapped_bytes, length - old_length, __ATOMIC_RELAXED);
+  if (length > old_length) {
+    COUNT(bytes_consumed, length - old_length);
+  }
+  return (void*)block_addr;
+
+} // mapped_realloc ()
+// ==============================================================================
+
+
+
+#if defined (HEADERLESS_ALLOC)
+// ==============================================================================
+/**
+ * Allocate a headerless block from the calling thread's page for its size
+ * class.  A new page is taken from the top of the thread's chunk, leaving the
+ * bottom to blocks with headers, so that neither wastes space aligning the
+ * other.
+ *
+ * \param class The size class of the block.
+ * \return      A pointer to the block, if successful; `NULL` if the heap is
+ *              full.
+ */
+static void* headerless_malloc (int class) {
+
+  tlab_s*  page       = &class_pages[class];
+  size_t   size       = class_size(class);
+  intptr_t block_addr = page->free_addr;
+
+  if (block_addr + (intptr_t)size > page->end_addr) {
+
+    intptr_t page_addr = ALIGN_DOWN(tlab.end_addr - (intptr_t)CLASS_PAGE, CLASS_PAGE);
+    if (page_addr < tlab.free_addr) {
+      if (!tlab_refill()) {
+	return NULL;
+      }
+      page_addr = ALIGN_DOWN(tlab.end_addr - (intptr_t)CLASS_PAGE, CLASS_PAGE);
+    }
+    tlab.end_addr = page_addr;
+
+    page_classes[(page_addr - heap.start_addr) / CLASS_PAGE] = class + 1;
+    page->end_addr = page_addr + CLASS_PAGE;
+    block_addr     = page_addr;
+
+  }
+
+  page->free_addr = block_addr + size;
+  COUNT(bytes_consumed, size);
+  return (void*)block_addr;
+
+} // headerless_malloc ()
+// ==============================================================================
+#endif /* HEADERLESS_ALLOC */
+
+
+
+// ==============================================================================
+/**
+ * Find the size of a block:  from its page's class if it is headerless, or
+ * from its header otherwise.
+ *
+ * \param ptr A pointer to a block returned by `malloc()`.
+ * \return    The number of usable bytes in the block.
+ */
+static size_t block_size (void* ptr) {
+
+#if defined (HEADERLESS_ALLOC)
+  if (in_heap(ptr)) {
+    uint8_t page_class = page_classes[((intptr_t)ptr - heap.start_addr) / CLASS_PAGE];
+    if (page_class != 0) {
+      return class_size(page_class - 1);
+    }
+  }
+#endif /* HEADERLESS_ALLOC */
+
+  return ((header_s*)((intptr_t)ptr - sizeof(header_s)))->size;
+
+} // block_size ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Grow a block in place, if it is the most recent allocation from either the
+ * calling thread's chunk or the shared heap, by bumping the corresponding free
+ * address past its new end.  Nothing needs to be copied.
+ *
+ * \param ptr      A pointer to the block.
+ * \param old_size The block's current size, from `block_size()`.
+ * \param size     The size that the block should have; larger than
+ *                 `old_size`.
+ * \return         `true` if the block was grown; `false` if it must move.
+ */
+static bool grow_in_place (void* ptr, size_t old_size, size_t size) {
+
+#if defined (HEADERLESS_ALLOC)
+  // A headerless block's size is its page's class.
+  if (page_classes[((intptr_t)ptr - heap.start_addr) / CLASS_PAGE] != 0) {
+    return false;
+  }
+#endif /* HEADERLESS_ALLOC */
+
+  if (size > (size_t)(heap.end_addr - (intptr_t)ptr)) {
+    return false;
+  }
+
+#if defined (RECYCLE_ALLOC)
+  // Keep the block's size a class size, so that free() can still file it.
+  if (size <= CLASS_MAX) {
+    size = class_size(size_class(size));
+  }
+#endif /* RECYCLE_ALLOC */
+
+  intptr_t old_end = (intptr_t)ptr + old_size + TRAILER_SIZE;
+  intptr_t new_end = (intptr_t)ptr + size + TRAILER_SIZE;
+  if (old_end == tlab.free_addr) {
+    if (new_end > tlab.end_addr) {
+      return false;
+    }
+    tlab.free_addr = new_end;
+  } else if (!region_extend(heap_region_of((intptr_t)ptr), old_end, new_end)) {
+    return false;
+  }
+
+  ((header_s*)((intptr_t)ptr - sizeof(header_s)))->size = size;
+  canary_set(ptr, size);
+  COUNT(bytes_consumed, new_end - old_end);
+  return true;
+
+} // grow_in_place ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Finish a block bumped from the heap:  store its size in its header, which
+ * sits directly before it, write its canaries, and count the space that it
+ * took.
+ *
+ * \param block_addr The block.
+ * \param start_addr Where the space taken for the block, padding and header
+ *                   included, begins.
+ * \param size       The size of the block, its trailer included.
+ * \return           A pointer to the block.
+ */
+static inline void* bump_finish (intptr_t block_addr, intptr_t start_addr, size_t size) {
+
+  header_s* header_ptr = (header_s*)(block_addr - sizeof(header_s));
+  header_ptr->size     = size - TRAILER_SIZE;
+  canary_set((void*)block_addr, size - TRAILER_SIZE);
+
+  thread_stats_s* counts = my_stats();
+  COUNT_TO(counts, bytes_consumed, block_addr + size - start_addr);
+  COUNT_TO(counts, bytes_header,   sizeof(header_s) + TRAILER_SIZE);
+  COUNT_TO(counts, bytes_padding,  block_addr - (intptr_t)sizeof(header_s) - start_addr);
+  return (void*)block_addr;
+
+} // bump_finish ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * The slow path of `bump()`:  refill the calling thread's chunk and bump the
+ * block from the new one, or, for a block too large for any chunk (or if the
+ * heap has no room for a new chunk), reserve it directly from the shared
+ * heap.
+ *
+ * \param size  The number of bytes to allocate; at most `MMAP_THRESHOLD`.
+ * \param align The alignment of the block; a power of 2, and at least
+ *              `BLOCK_ALIGN`.
+ * \return      A pointer to the allocated block, if successful; `NULL` if the
+ *              heap is full.
+ */
+__attribute__ ((noinline))
+static void* bump_slow (size_t size, size_t align) {
+
+  intptr_t block_addr;
+  intptr_t start_addr;
+  if (size <= TLAB_MAX_BLOCK && align <= TLAB_MAX_BLOCK && tlab_refill()) {
+    start_addr     = tlab.free_addr;
+    block_addr     = ALIGN_UP(start_addr + (intptr_t)sizeof(header_s), align);
+    tlab.free_addr = block_addr + size;
+#if defined (CHUNK_PURGE)
+    tlab_allocs += 1;
+#endif /* CHUNK_PURGE */
+    return bump_finish(block_addr, start_addr, size);
+  }
+
+  // If even that fails, return null to signify that the heap is full.
+  block_addr = heap_reserve(sizeof(header_s), size, align, &start_addr);
+  if (block_addr == 0) {
+    return NULL;
+  }
+  heap_prefault();
+  return bump_finish(block_addr, start_addr, size);
+
+} // bump_slow ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Bump a block with a header from the heap.  Small blocks are bumped from the
+ * calling thread's own chunk, which needs no synchronization:  the block
+ * starts at the first aligned address that leaves room for its header
+ * immediately before it, found with a single masked round-up.  Everything
+ * else takes the slow path.
+ *
+ * \param size  The number of bytes to allocate; at most `MMAP_THRESHOLD`.
+ * \param align The alignment of the block; a power of 2, and at least
+ *              `BLOCK_ALIGN`.
+ * \return      A pointer to the allocated block, if successful; `NULL` if the
+ *              heap is full.
+ */
+static inline void* bump (size_t size, size_t align) {
+
+  size += TRAILER_SIZE;
+  intptr_t start_addr = tlab.free_addr;
+  intptr_t block_addr = ALIGN_UP(start_addr + (intptr_t)sizeof(header_s), align);
+  if (__builtin_expect(block_addr + (intptr_t)size > tlab.end_addr ||
+		       size > TLAB_MAX_BLOCK || align > TLAB_MAX_BLOCK, false)) {
+    return bump_slow(size, align);
+  }
+
+  tlab.free_addr = block_addr + size;
+#if defined (CHUNK_PURGE)
+  tlab_allocs += 1;
+#endif /* CHUNK_PURGE */
+  return bump_finish(block_addr, start_addr, size);
+
+} // bump ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes of heap space, expanding into the heap region via
+ * _pointer bumping_, and report whether the space has ever been used before.
+ * Nothing below the bump frontier is ever handed out twice except through the
+ * free lists, so the frontier serves as the high-water mark of touched memory:
+ * a block bumped past it (or mapped for itself) is still zero-filled.
+ *
+ * \param size  The number of bytes to allocate.
+ * \param fresh Where to store whether the block is known to be zero-filled.
+ * \return      A pointer to the allocated block, if successful; `NULL` if
+ *              unsuccessful.
+ */
+static inline void* allocate (size_t size, bool* fresh) {
+  //initialize the heap if there is no heap region yet
+  ensure_init();
+  *fresh = true;
+  
+  // if requested size is 0, return nothing because there is nothing to do
+  if (size == 0) {
+    return NULL;
+  }
+
+  // Large blocks get mappings of their own.
+  if (size > MMAP_THRESHOLD) {
+    return mapped_malloc(size, config.align);
+  }
+
+  // Keep the size asked for, to count what rounding to a class costs.
+  size_t request = size;
+
+#if defined (RECYCLE_ALLOC)
+  // Round the request up to its size class, so that any freed block of that
+  // class can satisfy it, and reuse the most recently freed one if there is
+  // one.  Its header still holds the class size.
+  if (size <= CLASS_MAX) {
+    int           class = size_class(size);
+    free_block_s* block = free_lists[class];
+    if (block == NULL && queue_drain()) {
+      block = free_lists[class];
+    }
+    if (block != NULL) {
+      free_lists[class] = block->next;
+      *fresh            = false;
+      if (!block->purged && class_size(class) >= PURGE_BLOCK_MIN && config.purge_threshold > 0) {
+	unpurged_bytes -= class_size(class);
+      }
+      return block;
+    }
+    size = class_size(class);
+  }
+#endif /* RECYCLE_ALLOC */
+
+#if defined (HEADERLESS_ALLOC)
+  // Headerless blocks are only ever aligned to their class spacing.
+  if (size <= HEADERLESS_MAX && config.align <= CLASS_SPACING) {
+    int   class     = size_class(size);
+    void* block_ptr = headerless_malloc(class);
+    if (block_ptr != NULL) {
+      COUNT(bytes_rounding, class_size(class) - request);
+    }
+    return block_ptr;
+  }
+#endif /* HEADERLESS_ALLOC */
+
+  void* block_ptr = bump(size, config.align);
+  if (block_ptr != NULL && size > request) {
+    COUNT(bytes_rounding, size - request);
+  }
+  return block_ptr;
+
+} // allocate ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate and return `size` bytes of heap space.  Expand into the heap region
+ * via _pointer bumping_.
+ *
+ * \param size The number of bytes to allocate.
+
+ * \return A pointer to the allocated block, if successful; `NULL` if
+ *         unsuccessful.
+ */
+void* malloc (size_t size) {
+
+  bool  fresh;
+  void* block_ptr = allocate(size, &fresh);
+  COUNT(malloc_calls, 1);
+  count_request(size, 1);
+  trace(PB_TRACE_MALLOC, size, block_ptr, NULL, 0);
+  return block_ptr;
+
+} // malloc()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate a small block whose size the compiler knew; see `pb_malloc_fixed()`.
+ * Without size classes, the block is bumped straight from the calling
+ * thread's chunk, skipping the checks for empty and large requests.
+ *
+ * \param size The number of bytes to allocate; at least 1 and at most
+ *             `PB_FIXED_MAX`.
+ * \return     A pointer to the allocated block, if successful; `NULL` if
+ *             unsuccessful.
+ */
+void* pb_malloc_small (size_t size) {
+
+#if defined (RECYCLE_ALLOC) || defined (HEADERLESS_ALLOC)
+  bool  fresh;
+  void* block_ptr = allocate(size, &fresh);
+#else
+  ensure_init();
+  void* block_ptr = bump(size, config.align);
+#endif
+  COUNT(malloc_calls, 1);
+  count_request(size, 1);
+  trace(PB_TRACE_MALLOC, size, block_ptr, NULL, 0);
+  return block_ptr;
+
+} // pb_malloc_small ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `count` blocks of `size` bytes at once.  The blocks are laid out
+ * back to back, each after its header, in space taken with a single bump:  of
+ * the calling thread's chunk, if they fit in what is left of it, or else of
+ * the shared heap, with a single atomic operation.  One pass then writes
+ * every header and fills `blocks`.  Large blocks get mappings of their own,
+ * one at a time, as from `malloc()`.
+ *
+ * \param count  The number of blocks to allocate.
+ * \param size   The number of bytes in each block.
+ * \param blocks Where to store the pointers to the blocks.
+ * \return       The number of blocks allocated, stored at the start of
+ *               `blocks`; fewer than `count` only if the heap is full.
+ */
+size_t pb_malloc_batch (size_t count, size_t size, void** blocks) {
+
+  ensure_init();
+  if (count == 0 || size == 0) {
+    return 0;
+  }
+
+  // Keep each block's size a class size, so that free() can file it.
+  size_t rounded = size;
+#if defined (RECYCLE_ALLOC)
+  if (rounded <= CLASS_MAX) {
+    rounded = class_size(size_class(rounded));
+  }
+#endif /* RECYCLE_ALLOC */
+
+  // Each block starts one stride after the last, so that its header directly
+  // precedes it and it is aligned, as the first is.
+  size_t   align  = config.align;
+  size_t   stride = ALIGN_UP(sizeof(header_s) + rounded + TRAILER_SIZE, align);
+  size_t   span;
+  intptr_t block_addr = 0;
+  intptr_t start_addr = 0;
+  if (rounded <= MMAP_THRESHOLD && !__builtin_mul_overflow(count - 1, stride, &span) &&
+      !__builtin_add_overflow(span, rounded + TRAILER_SIZE, &span)) {
+
+    block_addr = ALIGN_UP(tlab.free_addr + (intptr_t)sizeof(header_s), align);
+    if (block_addr <= tlab.end_addr && span <= (size_t)(tlab.end_addr - block_addr)) {
+      start_addr     = tlab.free_addr;
+      tlab.free_addr = block_addr + span;
+#if defined (CHUNK_PURGE)
+      tlab_allocs += count;
+#endif /* CHUNK_PURGE */
+    } else {
+      block_addr = heap_reserve(sizeof(header_s), span, align, &start_addr);
+      if (block_addr != 0) {
+	heap_prefault();
+      }
+    }
+
+  }
+
+  // Without space for the whole batch, allocate the blocks one at a time,
+  // for as long as there is room.
+  if (block_addr == 0) {
+    size_t allocated = 0;
+    for (; allocated < count; allocated += 1) {
+      blocks[allocated] = malloc(size);
+      if (blocks[allocated] == NULL) {
+	break;
+      }
+    }
+    return allocated;
+  }
+
+  for (size_t i = 0; i < count; i += 1) {
+    ((header_s*)block_addr)[-1].size = rounded;
+    canary_set((void*)block_addr, rounded);
+    blocks[i]   = (void*)block_addr;
+    block_addr += stride;
+  }
+
+  thread_stats_s* counts = my_stats();
+  COUNT_TO(counts, malloc_calls,   count);
+  COUNT_TO(counts, bytes_consumed, (intptr_t)blocks[0] + span - start_addr);
+  COUNT_TO(counts, bytes_header,   count * (sizeof(header_s) + TRAILER_SIZE));
+  COUNT_TO(counts, bytes_padding,  (intptr_t)blocks[0] + span - start_addr
+	   - count * (sizeof(header_s) + rounded + TRAILER_SIZE));
+  COUNT_TO(counts, bytes_rounding, count * (rounded - size));
+  count_request(size, count);
+  if (config.trace_prefix != NULL) {
+    for (size_t i = 0; i < count; i += 1) {
+      trace(PB_TRACE_MALLOC, size, blocks[i], NULL, 0);
+    }
+  }
+
+  return count;
+
+} // pb_malloc_batch ()
+// ==============================================================================
+
+
+
+#if defined (RECYCLE_ALLOC)
+// ==============================================================================
+/**
+ * Release the pages within the calling thread's recycled blocks, except for
+ * the first page of each, which holds its link.  Lists are taken from the
+ * top, where new blocks are pushed, down to the first block already purged.
+ * `MADV_FREE` lets the system take the pages only if it needs them; kernels
+ * that lack it drop them at once instead.
+ */
+static void free_lists_purge () {
+
+  for (int class = size_class(PURGE_BLOCK_MIN); class < NUM_CLASSES; class += 1) {
+    size_t size = class_size(class);
+    for (free_block_s* block = free_lists[class];
+	 block != NULL && !block->purged;
+	 block = block->next) {
+      intptr_t first = ALIGN_UP((intptr_t)block + (intptr_t)sizeof(free_block_s), PAGE_SIZE);
+      intptr_t last  = ALIGN_DOWN((intptr_t)block + (intptr_t)size, PAGE_SIZE);
+      if (last > first) {
+	if (madvise((void*)first, last - first, MADV_FREE) != 0) {
+	  madvise((void*)first, last - first, MADV_DONTNEED);
+	}
+	__atomic_add_fetch(&bytes_purged, last - first, __ATOMIC_RELAXED);
+      }
+      block->purged = true;
+    }
+  }
+  unpurged_bytes = 0;
+
+} // free_lists_purge ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Push a block onto the calling thread's free list for its size class.  Once
+ * the thread holds more than `purge_threshold` bytes of blocks large enough
+ * to purge, their pages are released.
+ *
+ * \param block The block.
+ * \param class The size class of the block; at most its actual size.
+ */
+static void free_list_push (free_block_s* block, int class) {
+
+  block->next         = free_lists[class];
+  block->purged       = false;
+  free_lists[class]   = block;
+
+  size_t size = class_size(class);
+  if (size >= PURGE_BLOCK_MIN && config.purge_threshold > 0) {
+    unpurged_bytes += size;
+    if (unpurged_bytes > config.purge_threshold) {
+      free_lists_purge();
+    }
+  }
+
+} // free_list_push ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Push a chain of blocks onto a remote-free queue.
+ *
+ * \param queue The queue.
+ * \param first The first block of the chain.
+ * \param last  The last block of the chain, whose link is overwritten.
+ */
+static void queue_push (remote_queue_s* queue, free_block_s* first, free_block_s* last) {
+
+  last->next = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&queue->head, &last->next, first,
+				      true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+} // queue_push ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Move every block that other threads have pushed onto the calling thread's
+ * remote-free queue onto its free lists.
+ *
+ * \return `true` if there were any blocks; `false` if the queue was empty.
+ */
+static bool queue_drain () {
+
+  if (my_queue == NULL || __atomic_load_n(&my_queue->head, __ATOMIC_RELAXED) == NULL) {
+    return false;
+  }
+
+  free_block_s* block = __atomic_exchange_n(&my_queue->head, NULL, __ATOMIC_ACQUIRE);
+  while (block != NULL) {
+    free_block_s* next = block->next;
+    free_list_push(block, block->class);
+    block = next;
+  }
+  return true;
+
+} // queue_drain ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Push a thread's free lists onto its remote-free queue, emptying them, so
+ * that whichever thread next adopts the queue takes the blocks.
+ *
+ * \param queue The thread's queue.
+ * \param lists The thread's free lists.
+ */
+static void free_lists_hand_on (remote_queue_s* queue, free_block_s** lists) {
+
+  for (int class = 0; class < NUM_CLASSES; class += 1) {
+    free_block_s* first = lists[class];
+    if (first == NULL) {
+      continue;
+    }
+    free_block_s* last = first;
+    for (;;) {
+      last->class = class;
+      if (last->next == NULL) {
+	break;
+      }
+      last = last->next;
+    }
+    queue_push(queue, first, last);
+    lists[class] = NULL;
+  }
+
+} // free_lists_hand_on ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Leave an exiting thread's remote-free queue for the next new thread, with
+ * the thread's free lists pushed onto it, so that no recycled block is lost
+ * with the thread.
+ *
+ * \param queue The thread's queue.
+ */
+static void queue_release (void* queue) {
+
+  free_lists_hand_on((remote_queue_s*)queue, free_lists);
+  unpurged_bytes = 0;
+
+  my_queue = NULL;
+  __atomic_store_n(&((remote_queue_s*)queue)->in_use, false, __ATOMIC_RELEASE);
+
+} // queue_release ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Recycle a freed block:  onto the calling thread's own free list, or, if the
+ * block was carved from another thread's chunk, onto that thread's
+ * remote-free queue.
+ *
+ * \param ptr   A pointer to the block.
+ * \param class The size class of the block; at most its actual size.
+ */
+static void recycle (void* ptr, int class) {
+
+  free_block_s*   block = (free_block_s*)ptr;
+  remote_queue_s* owner = NULL;
+  if (chunk_owners != NULL) {
+    owner = __atomic_load_n(owner_slot((intptr_t)ptr), __ATOMIC_RELAXED);
+  }
+
+  if (owner != NULL && owner != my_queue) {
+    block->class = class;
+    queue_push(owner, block, block);
+  } else {
+    free_list_push(block, class);
+  }
+
+} // recycle ()
+// ==============================================================================
+#endif /* RECYCLE_ALLOC */
+
+
+
+// ==============================================================================
+/**
+ * Deallocate a given block on the heap.  Add the given block to the free
+ * list.  Unless compiled with `RECYCLE_ALLOC`, this does nothing, except to
+ * unmap large blocks and to count the block against its chunk.
+ *
+ * \param ptr A pointer to the block to be deallocated; not `NULL`.
+ */
+static void release (void* ptr) {
+
+  canary_check(ptr);
+
+  // A large block's mapping goes straight back to the system, guard and all.
+  if (!in_heap(ptr)) {
+    intptr_t mapping = mapping_start(ptr);
+    size_t   length  = (intptr_t)ptr + block_size(ptr) + TRAILER_SIZE - mapping;
+    munmap((void*)mapping, length + config.guard_size);
+    __atomic_sub_fetch(&mapped_blocks, 1,      __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&mapped_bytes,  length, __ATOMIC_RELAXED);
+    return;
+  }
+
+#if defined (RECYCLE_ALLOC)
+  // The block's class size picks the free list that the block joins.  Blocks
+  // larger than every class are not recycled.
+  size_t size = block_size(ptr);
+  if (size <= CLASS_MAX) {
+    recycle(ptr, size_class(size));
+  }
+#endif /* RECYCLE_ALLOC */
+
+#if defined (CHUNK_PURGE)
+  chunk_free(ptr);
+#endif /* CHUNK_PURGE */
+
+} // release ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Deallocate a given block on the heap, if there is one.
+ *
+ * \param ptr A pointer to the block to be deallocated, or `NULL`.
+ */
+void free (void* ptr) {
+
+  DEBUG("free(): ", (intptr_t)ptr);
+
+  if (ptr == NULL) {
+    return;
+  }
+
+  COUNT(free_calls, 1);
+  trace(PB_TRACE_FREE, 0, ptr, NULL, 0);
+  release(ptr);
+
+} // free()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Deallocate a block whose size the caller knows, as in C23.  When recycling,
+ * the size picks the block's free list directly, without reading its header
+ * or page class.
+ *
+ * \param ptr  A pointer to the block to be deallocated.
+ * \param size The size with which the block was allocated (or last
+ *             reallocated).
+ */
+void free_sized (void* ptr, size_t size) {
+
+#if defined (RECYCLE_ALLOC)
+  // Every block of a class is at least that class's size, so filing the
+  // block under the class of the size it was requested with is always safe.
+  if (ptr != NULL && size != 0 && size <= CLASS_MAX && in_heap(ptr)) {
+    DEBUG("free_sized(): ", (intptr_t)ptr, size);
+    COUNT(free_calls, 1);
+    trace(PB_TRACE_FREE, 0, ptr, NULL, 0);
+    canary_check(ptr);
+    recycle(ptr, size_class(size));
+    return;
+  }
+#endif /* RECYCLE_ALLOC */
+
+  free(ptr);
+
+} // free_sized ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Deallocate a block whose size and alignment the caller knows, as in C23.
+ * Aligned blocks have ordinary headers, so the alignment is not needed.
+ *
+ * \param ptr       A pointer to the block to be deallocated.
+ * \param alignment The alignment with which the block was allocated.
+ * \param size      The size with which the block was allocated.
+ */
+void free_aligned_sized (void* ptr, size_t alignment, size_t size) {
+
+  free_sized(ptr, size);
+
+} // free_aligned_sized ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Find the number of usable bytes in a block, which may exceed the size it
+ * was requested with.
+ *
+ * \param ptr A pointer to a block, or `NULL`.
+ * \return    The block's usable size; `0` for `NULL`.
+ */
+size_t malloc_usable_size (void* ptr) {
+
+  return ptr == NULL ? 0 : block_size(ptr);
+
+} // malloc_usable_size ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate a block of `nmemb * size` bytes on the heap, zeroing its contents.
+ * Only a recycled block needs to be cleared; fresh space is already zero,
+ * and leaving it alone also leaves its pages untouched until they are used.
+ *
+ * \param nmemb The number of elements in the new block.
+ * \param size  The size, in bytes, of each of the `nmemb` elements.
+ * \return      A pointer to the newly allocated and zeroed block, if successful;
+ *              `NULL` if unsuccessful.
+ */
+void* calloc (size_t nmemb, size_t size) {
+
+  // Refuse requests whose total size overflows.
+  size_t total_size;
+  if (__builtin_mul_overflow(nmemb, size, &total_size)) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  // Allocate a block of the requested size.
+  bool  fresh;
+  void* block_ptr = allocate(total_size, &fresh);
+  COUNT(calloc_calls, 1);
+  count_request(total_size, 1);
+  trace(PB_TRACE_CALLOC, total_size, block_ptr, NULL, 0);
+
+  // If the allocation succeeded with used space, clear the entire block.
+  if (block_ptr != NULL && !fresh) {
+    memset(block_ptr, 0, total_size);
+  }
+
+  return block_ptr;
+  
+} // calloc ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Resize a block, as `realloc()` does, counting how.
+ *
+ * \param ptr  The block to be assigned a new size, or `NULL`.
+ * \param size The new size that the block should assume.
+ * \return     A pointer to the resultant block.
+ */
+static void* reallocate (void* ptr, size_t size) {
+
+  bool fresh;
+
+  // if there is no given block, then simply return
+  // a new block of given size
+  if (ptr == NULL) {
+    return allocate(size, &fresh);
+  }
+
+  // if the requested size is 0, then free the current block as
+  // it is no longer needed. Return NULL to signify a block of size 0.
+  if (size == 0) {
+    release(ptr);
+    return NULL;
+  }
+  
+  // find the size of the old block, which is usually stored in its header
+  canary_check(ptr);
+  size_t old_size = block_size(ptr);
+
+  // if the requested size is less than the old size, then the old block
+  // is sufficient and the old pointer can be returned
+  if (size <= old_size) {
+    COUNT(realloc_in_place, 1);
+    return ptr;
+  }
+
+  // a large block is moved by remapping its pages rather than copying them
+  if (!in_heap(ptr)) {
+    void* new_ptr = mapped_realloc(ptr, size);
+    if (new_ptr == ptr) {
+      COUNT(realloc_in_place, 1);
+    } else if (new_ptr != NULL) {
+      COUNT(realloc_remaps, 1);
+    }
+    return new_ptr;
+  }
+
+  // if nothing was allocated after the old block, it can simply be extended,
+  // unless it would outgrow the heap's largest size; then it is copied once
+  // into a mapping of its own, which further growth remaps
+  if (size <= MMAP_THRESHOLD && grow_in_place(ptr, old_size, size)) {
+    COUNT(realloc_in_place, 1);
+    return ptr;
+  }
+  
+  // if the requested size is more than the size of the old block then a new
+  // block must be allocated
+  void* new_ptr = allocate(size, &fresh);
 
   // as long as the newly allocated block of the requested size was allocated successfully,
   // copy the contents of the old block to the new block and free the current pointer
   // to the old block
   if (new_ptr != NULL) {
     memcpy(new_ptr, ptr, old_size);
-    free(ptr);
+    release(ptr);
+    COUNT(realloc_copies, 1);
+  }
+
+  // return the pointer to the new block with contents copied over
+  return new_ptr;
+  
+} // reallocate ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Update the given block at `ptr` to take on the given `size`.  Here, if `size`
+ * fits within the given block, then the block is returned unchanged.  If the
+ * `size` is an increase for the block, and nothing has been allocated after
+ * it, then it is grown in place.  Otherwise, a new and larger block is
+ * allocated, and the data from the old block is copied, the old block freed,
+ * and the new block returned.
+ *
+ * \param ptr  The block to be assigned a new size.
+ * \param size The new size that the block should assume.
+ * \return     A pointer to the resultant block, which may be `ptr` itself, or
+ *             may be a newly allocated block.
+ */
+void* realloc (void* ptr, size_t size) {
+
+  COUNT(realloc_calls, 1);
+  count_request(size, 1);
+  void* new_ptr = reallocate(ptr, size);
+  trace(PB_TRACE_REALLOC, size, new_ptr, ptr, 0);
+  return new_ptr;
+
+} // realloc()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes of heap space aligned to `align`.  The block is bumped
+ * like any other, but from an `align` boundary, with its header directly
+ * before it; it is never headerless.
+ *
+ * \param align The alignment of the block; a power of 2.
+ * \param size  The number of bytes to allocate.
+ * \return      A pointer to the allocated block, if successful; `NULL` if
+ *              unsuccessful.
+ */
+static void* allocate_aligned (size_t align, size_t size) {
+
+  ensure_init();
+  COUNT(malloc_calls, 1);
+  count_request(size, 1);
+
+  void* block_ptr;
+  bool  fresh;
+  if (align <= config.align) {
+    block_ptr = allocate(size, &fresh);
+  } else if (size == 0) {
+    block_ptr = NULL;
+  } else if (size > MMAP_THRESHOLD || align > MMAP_THRESHOLD) {
+    block_ptr = mapped_malloc(size, align);
+  } else {
+    size_t rounded = size;
+#if defined (RECYCLE_ALLOC)
+    // Keep the block's size a class size, so that free() can file it.
+    if (rounded <= CLASS_MAX) {
+      rounded = class_size(size_class(rounded));
+    }
+#endif /* RECYCLE_ALLOC */
+    block_ptr = bump(rounded, align);
+  }
+
+  trace(PB_TRACE_ALIGNED, size, block_ptr, NULL, align);
+  return block_ptr;
+
+} // allocate_aligned ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/** Determine whether `value` is a power of 2. */
+static bool is_power_of_2 (size_t value) {
+  return value != 0 && (value & (value - 1)) == 0;
+}
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes aligned to `alignment`, storing the block in
+ * `*memptr`.
+ *
+ * \param memptr    Where to store the pointer to the allocated block.
+ * \param alignment A power of 2 that is a multiple of `sizeof(void*)`.
+ * \param size      The number of bytes to allocate.
+ * \return          `0` if successful; `EINVAL` if `alignment` is invalid;
+ *                  `ENOMEM` if there is no space.
+ */
+int posix_memalign (void** memptr, size_t alignment, size_t size) {
+
+  if (!is_power_of_2(alignment) || alignment % sizeof(void*) != 0) {
+    return EINVAL;
+  }
+
+  void* block_ptr = allocate_aligned(alignment, size);
+  if (block_ptr == NULL && size != 0) {
+    return ENOMEM;
+  }
+
+  *memptr = block_ptr;
+  return 0;
+
+} // posix_memalign ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes aligned to `alignment`, as in C11.
+ *
+ * \param alignment A power of 2.
+ * \param size      The number of bytes to allocate.
+ * \return          A pointer to the allocated block, if successful; `NULL` if
+ *                  unsuccessful.
+ */
+void* aligned_alloc (size_t alignment, size_t size) {
+
+  if (!is_power_of_2(alignment)) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  return allocate_aligned(alignment, size);
+
+} // aligned_alloc ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes aligned to `alignment`.  As in glibc, an alignment
+ * no greater than a block's own (including `0`) is ignored, and one that is
+ * not a power of 2 is rounded up to one.
+ *
+ * \param alignment The alignment of the block.
+ * \param size      The number of bytes to allocate.
+ * \return          A pointer to the allocated block, if successful; `NULL` if
+ *                  unsuccessful.
+ */
+void* memalign (size_t alignment, size_t size) {
+
+  ensure_init();
+  if (alignment <= config.align) {
+    return allocate_aligned(config.align, size);
+  }
+
+  // Check the limit for every alignment, not just those to be rounded.  As the
+  // limit is a power of 2, no alignment within it rounds up past it.
+  if (alignment > HEAP_SIZE) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (!is_power_of_2(alignment)) {
+    alignment = (size_t)1 << (64 - __builtin_clzll(alignment));
+  }
+
+  return allocate_aligned(alignment, size);
+
+} // memalign ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes aligned to a page.
+ *
+ * \param size The number of bytes to allocate.
+ * \return     A pointer to the allocated block, if successful; `NULL` if
+ *             unsuccessful.
+ */
+void* valloc (size_t size) {
+
+  return allocate_aligned(PAGE_SIZE, size);
+
+} // valloc ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes, rounded up to a whole number of pages, aligned to a
+ * page.
+ *
+ * \param size The number of bytes to allocate.
+ * \return     A pointer to the allocated block, if successful; `NULL` if
+ *             unsuccessful.
+ */
+void* pvalloc (size_t size) {
+
+  size_t page_size = PAGE_SIZE;
+  if (size > HEAP_SIZE) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  return allocate_aligned(page_size, size == 0 ? page_size : ALIGN_UP(size, page_size));
+
+} // pvalloc ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Gather the allocator's statistics by summing every thread's counters.
+ *
+ * \param stats Where to store the statistics.
+ */
+void pb_stats (pb_stats_t* stats) {
+
+  init();
+  memset(stats, 0, sizeof(pb_stats_t));
+
+  thread_stats_s* record = &orphan_stats;
+  thread_stats_s* next   = __atomic_load_n(&all_stats, __ATOMIC_ACQUIRE);
+  while (record != NULL) {
+    stats->malloc_calls     += __atomic_load_n(&record->malloc_calls,     __ATOMIC_RELAXED);
+    stats->calloc_calls     += __atomic_load_n(&record->calloc_calls,     __ATOMIC_RELAXED);
+    stats->realloc_calls    += __atomic_load_n(&record->realloc_calls,    __ATOMIC_RELAXED);
+    stats->free_calls       += __atomic_load_n(&record->free_calls,       __ATOMIC_RELAXED);
+    stats->bytes_requested  += __atomic_load_n(&record->bytes_requested,  __ATOMIC_RELAXED);
+    stats->bytes_consumed   += __atomic_load_n(&record->bytes_consumed,   __ATOMIC_RELAXED);
+    stats->bytes_header     += __atomic_load_n(&record->bytes_header,     __ATOMIC_RELAXED);
+    stats->bytes_padding    += __atomic_load_n(&record->bytes_padding,    __ATOMIC_RELAXED);
+    stats->bytes_rounding   += __atomic_load_n(&record->bytes_rounding,   __ATOMIC_RELAXED);
+    for (int bucket = 0; bucket < PB_SIZE_BUCKETS; bucket += 1) {
+      stats->size_histogram[bucket] += __atomic_load_n(&record->size_histogram[bucket],
+						       __ATOMIC_RELAXED);
+    }
+    stats->realloc_in_place += __atomic_load_n(&record->realloc_in_place, __ATOMIC_RELAXED);
+    stats->realloc_remaps   += __atomic_load_n(&record->realloc_remaps,   __ATOMIC_RELAXED);
+    stats->realloc_copies   += __atomic_load_n(&record->realloc_copies,   __ATOMIC_RELAXED);
+    record = next;
+    next   = (next != NULL) ? next->next : NULL;
   }
 
-  // return the pointer to the new block with contents copied over
-  return new_ptr;
-  
-} // realloc()
+  int       regions = (config.numa_nodes == 0) ? 1 : config.numa_nodes;
+  region_s* region  = (config.numa_nodes == 0) ? &heap : node_heaps;
+  for (int i = 0; i < regions; i += 1, region += 1) {
+    stats->heap_high_water += __atomic_load_n(&region->free_addr,   __ATOMIC_RELAXED) - region->start_addr;
+    stats->heap_committed  += __atomic_load_n(&region->commit_addr, __ATOMIC_RELAXED) - region->start_addr;
+  }
+  stats->bytes_purged    = __atomic_load_n(&bytes_purged,     __ATOMIC_RELAXED);
+
+} // pb_stats ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * At exit, if `PB_STATS` is set, print the statistics.  A destructor rather
+ * than `atexit()`, which may allocate, and so cannot be called from `init()`.
+ */
+__attribute__ ((destructor))
+static void stats_dump () {
+
+  if (!config.stats) {
+    return;
+  }
+
+  pb_stats_t stats;
+  pb_stats(&stats);
+  INFO("pb-alloc stats: malloc() calls",           stats.malloc_calls);
+  INFO("pb-alloc stats: calloc() calls",           stats.calloc_calls);
+  INFO("pb-alloc stats: realloc() calls",          stats.realloc_calls);
+  INFO("pb-alloc stats: free() calls",             stats.free_calls);
+  INFO("pb-alloc stats: bytes requested",          stats.bytes_requested);
+  INFO("pb-alloc stats: bytes consumed",           stats.bytes_consumed);
+  INFO("pb-alloc stats: ... by headers",           stats.bytes_header);
+  INFO("pb-alloc stats: ... by padding",           stats.bytes_padding);
+  INFO("pb-alloc stats: ... by rounding",          stats.bytes_rounding);
+  INFO("pb-alloc stats: realloc() in place",       stats.realloc_in_place);
+  INFO("pb-alloc stats: realloc() remaps",         stats.realloc_remaps);
+  INFO("pb-alloc stats: realloc() copies",         stats.realloc_copies);
+  INFO("pb-alloc stats: heap high-water mark",     stats.heap_high_water);
+  INFO("pb-alloc stats: heap committed",           stats.heap_committed);
+  INFO("pb-alloc stats: bytes purged",             stats.bytes_purged);
+  for (int bucket = 0; bucket < PB_SIZE_BUCKETS; bucket += 1) {
+    if (stats.size_histogram[bucket] != 0) {
+      INFO("pb-alloc stats: requests of at most (bytes), count",
+	   (uint64_t)1 << bucket, stats.size_histogram[bucket]);
+    }
+  }
+
+} // stats_dump ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Write out whatever is in an output buffer.
+ *
+ * \param output The buffer.
+ */
+static void output_flush (output_s* output) {
+
+  size_t written = 0;
+  while (written < output->length) {
+    ssize_t result = write(output->fd, output->buffer + written, output->length - written);
+    if (result <= 0) {
+      break;
+    }
+    written += result;
+  }
+  output->length = 0;
+
+} // output_flush ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Append a string to an output buffer.
+ *
+ * \param output The buffer.
+ * \param string The string to append.
+ */
+static void output_string (output_s* output, const char* string) {
+
+  for (; *string != '\0'; string += 1) {
+    if (output->length == sizeof(output->buffer)) {
+      output_flush(output);
+    }
+    output->buffer[output->length++] = *string;
+  }
+
+} // output_string ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Append a number to an output buffer.
+ *
+ * \param output The buffer.
+ * \param value  The number to append.
+ * \param base   The base in which to write it:  10, or 16 with a `0x` prefix.
+ */
+static void output_number (output_s* output, uint64_t value, int base) {
+
+  char  digits[24];
+  char* digit = &digits[sizeof(digits) - 1];
+  *digit = '\0';
+  do {
+    *--digit = "0123456789abcdef"[value % base];
+    value   /= base;
+  } while (value != 0);
+  if (base == 16) {
+    *--digit = 'x';
+    *--digit = '0';
+  }
+  output_string(output, digit);
+
+} // output_number ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Copy a consistent snapshot of a sample out of the profiler's ring.
+ *
+ * \param slot The sample's slot in the ring.
+ * \param copy Where to copy the sample.
+ * \return     `true` if the slot held a whole sample; `false` if it was empty
+ *             or being written.
+ */
+static bool sample_copy (sample_s* slot, sample_s* copy) {
+
+  size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+  if (seq == 0) {
+    return false;
+  }
+  memcpy(copy, slot, sizeof(sample_s));
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq && copy->depth <= SAMPLE_DEPTH;
+
+} // sample_copy ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Write the profiler's samples to a file, in the legacy text format of
+ * pprof's heap profiles (`heap_v2`).  Frees are not tracked, so the
+ * in-use figures are the same as the allocated ones.
+ *
+ * \param path The file to write.
+ * \return     `true` if the profile was written; `false` if profiling is
+ *             disabled or the file could not be opened.
+ */
+bool pb_profile_dump (const char* path) {
+
+  init();
+  if (samples == NULL) {
+    return false;
+  }
+
+  output_s output = { .length = 0 };
+  output.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (output.fd < 0) {
+    return false;
+  }
+
+  // The totals come first, so the samples are read twice.
+  sample_s copy;
+  uint64_t total_count = 0;
+  uint64_t total_bytes = 0;
+  for (int slot = 0; slot < SAMPLE_RING; slot += 1) {
+    if (sample_copy(&samples[slot], &copy)) {
+      total_count += 1;
+      total_bytes += copy.size;
+    }
+  }
+  for (int part = 0; part < 2; part += 1) {
+    output_string(&output, part == 0 ? "heap profile: " : " [");
+    output_number(&output, total_count, 10);
+    output_string(&output, ": ");
+    output_number(&output, total_bytes, 10);
+  }
+  output_string(&output, "] @ heap_v2/");
+  output_number(&output, config.sample_interval, 10);
+  output_string(&output, "\n");
+
+  for (int slot = 0; slot < SAMPLE_RING; slot += 1) {
+    if (!sample_copy(&samples[slot], &copy)) {
+      continue;
+    }
+    output_string(&output, "1: ");
+    output_number(&output, copy.size, 10);
+    output_string(&output, " [1: ");
+    output_number(&output, copy.size, 10);
+    output_string(&output, "] @");
+    for (int frame = 0; frame < copy.depth; frame += 1) {
+      output_string(&output, " ");
+      output_number(&output, (uint64_t)(intptr_t)copy.frames[frame], 16);
+    }
+    output_string(&output, "\n");
+  }
+
+  // pprof finds the symbols through the process's mappings.
+  output_string(&output, "\nMAPPED_LIBRARIES:\n");
+  output_flush(&output);
+  int maps = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+  if (maps >= 0) {
+    ssize_t length;
+    while ((length = read(maps, output.buffer, sizeof(output.buffer))) > 0) {
+      output.length = length;
+      output_flush(&output);
+    }
+    close(maps);
+  }
+
+  close(output.fd);
+  return true;
+
+} // pb_profile_dump ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * At exit, if `PB_PROFILE` names a file and profiling is enabled, write the
+ * profile to it.
+ */
+__attribute__ ((destructor))
+static void profile_dump_at_exit () {
+
+  const char* path = getenv("PB_PROFILE");
+  if (path != NULL && samples != NULL) {
+    pb_profile_dump(path);
+  }
+
+} // profile_dump_at_exit ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Before a fork, take the allocator's locks, so that the child gets them in a
+ * consistent state, and make sure the heap exists, so that the child never
+ * finds it half initialized.  The locks are taken in the order in which
+ * `heap_populate()` nests them.  The forking thread's buffered messages are
+ * written first, lest the child inherit them and write them again.
+ */
+static void fork_prepare () {
+
+  init();
+  safe_flush();
+  pthread_mutex_lock(&prefault_lock);
+  pthread_mutex_lock(&heap_lock);
+
+} // fork_prepare ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/** After a fork, in the parent:  release the locks that `fork_prepare()` took. */
+static void fork_parent () {
+
+  pthread_mutex_unlock(&heap_lock);
+  pthread_mutex_unlock(&prefault_lock);
+
+} // fork_parent ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * After a fork, in the child, of which the forking thread is the only thread:
+ * reset the locks, and leave the statistics records and remote-free queues
+ * of every other thread for new threads to adopt, as if those threads had
+ * exited.  Their chunks are sealed and their free lists handed on too, as at
+ * exit; their thread-local state was copied with the rest of the address
+ * space, so it can still be read.
+ * The trace window is shared with the parent's file, so the child drops it
+ * and starts traces of its own.
+ */
+static void fork_child () {
+
+  pthread_mutex_init(&heap_lock, NULL);
+  pthread_mutex_init(&prefault_lock, NULL);
+
+  for (thread_stats_s* record = all_stats; record != NULL; record = record->next) {
+    if (record != thread_stats) {
+#if defined (CHUNK_PURGE)
+      if (record->in_use) {
+	chunk_seal(record->tlab, *record->tlab_allocs);
+      }
+#endif /* CHUNK_PURGE */
+      record->in_use = false;
+    }
+  }
+
+#if defined (RECYCLE_ALLOC)
+  for (remote_queue_s* queue = all_queues; queue != NULL; queue = queue->next) {
+    if (queue != my_queue) {
+      if (queue->in_use) {
+	free_lists_hand_on(queue, queue->free_lists);
+      }
+      queue->in_use = false;
+    }
+  }
+#endif /* RECYCLE_ALLOC */
+
+  if (trace_state.window != NULL) {
+    munmap(trace_state.window, TRACE_WINDOW);
+    close(trace_state.fd);
+  }
+  memset(&trace_state, 0, sizeof(trace_state));
+  trace_threads = 0;
+
+} // fork_child ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Return a region's committed space beyond its bump pointer, except for
+ * `pad` bytes, to the system, and make it inaccessible again, as if it had
+ * never been committed.  `commit_addr` is lowered before `free_addr` is read,
+ * so that a thread reserving space meanwhile either is seen here or finds the
+ * lowered `commit_addr` and waits on `heap_lock` to recommit.  Both locks
+ * must be held.
+ *
+ * \param region The region to trim.
+ * \param pad    The bytes to leave committed beyond the bump pointer.
+ * \return       The number of bytes returned.
+ */
+static size_t region_trim (region_s* region, size_t pad) {
+
+  intptr_t old_commit = region->commit_addr;
+  intptr_t keep_addr  = ALIGN_UP(__atomic_load_n(&region->free_addr, __ATOMIC_RELAXED) +
+				 (intptr_t)pad, PAGE_SIZE);
+  if (keep_addr >= old_commit) {
+    return 0;
+  }
+  __atomic_store_n(&region->commit_addr, keep_addr, __ATOMIC_SEQ_CST);
+
+  // Raising commit_addr again, over space that is still committed, is safe.
+  intptr_t free_addr = ALIGN_UP(__atomic_load_n(&region->free_addr, __ATOMIC_SEQ_CST) +
+				(intptr_t)pad, PAGE_SIZE);
+  if (free_addr > keep_addr) {
+    keep_addr = (free_addr < old_commit) ? free_addr : old_commit;
+    __atomic_store_n(&region->commit_addr, keep_addr, __ATOMIC_RELEASE);
+    if (keep_addr == old_commit) {
+      return 0;
+    }
+  }
+
+  mprotect((void*)keep_addr, old_commit - keep_addr, PROT_NONE);
+  madvise((void*)keep_addr, old_commit - keep_addr, MADV_DONTNEED);
+  if (region == &heap && populate_addr > keep_addr) {
+    __atomic_store_n(&populate_addr, keep_addr, __ATOMIC_RELAXED);
+  }
+  return old_commit - keep_addr;
+
+} // region_trim ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Return unused memory to the system:  the committed space beyond each heap
+ * region's bump pointer, and, when recycling, the pages of the calling
+ * thread's recycled blocks (see `free_lists_purge()`).  Other threads' chunks
+ * and free lists are left alone.
+ *
+ * \param pad The bytes to leave committed beyond each region's bump pointer.
+ * \return    `1` if any memory was returned; `0` if none.
+ */
+int malloc_trim (size_t pad) {
+
+  init();
+  size_t released = 0;
+
+#if defined (RECYCLE_ALLOC)
+  size_t purged_before = __atomic_load_n(&bytes_purged, __ATOMIC_RELAXED);
+  queue_drain();
+  free_lists_purge();
+  released += __atomic_load_n(&bytes_purged, __ATOMIC_RELAXED) - purged_before;
+#endif /* RECYCLE_ALLOC */
+
+  pthread_mutex_lock(&prefault_lock);
+  pthread_mutex_lock(&heap_lock);
+  int       regions = (config.numa_nodes == 0) ? 1 : config.numa_nodes;
+  region_s* region  = (config.numa_nodes == 0) ? &heap : node_heaps;
+  for (int i = 0; i < regions; i += 1, region += 1) {
+    released += region_trim(region, pad);
+  }
+  pthread_mutex_unlock(&heap_lock);
+  pthread_mutex_unlock(&prefault_lock);
+
+  return released > 0;
+
+} // malloc_trim ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Describe the heap in glibc's terms.  The heap is one "arena" of committed
+ * space, of which the part below the bump pointers is in use, and the rest
+ * free and trimmable.  Blocks waiting on free lists count as in use.
+ *
+ * \return The description.
+ */
+struct mallinfo2 mallinfo2 (void) {
+
+  pb_stats_t stats;
+  pb_stats(&stats);
+
+  struct mallinfo2 info = { 0 };
+  info.arena    = stats.heap_committed;
+  info.ordblks  = (stats.heap_committed > stats.heap_high_water) ? 1 : 0;
+  info.hblks    = __atomic_load_n(&mapped_blocks, __ATOMIC_RELAXED);
+  info.hblkhd   = __atomic_load_n(&mapped_bytes,  __ATOMIC_RELAXED);
+  info.uordblks = stats.heap_high_water;
+  info.fordblks = stats.heap_committed - stats.heap_high_water;
+  info.keepcost = info.fordblks;
+  return info;
+
+} // mallinfo2 ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Describe the heap, as `mallinfo2()` does, in `int` fields, which truncate
+ * large values just as glibc's do.
+ *
+ * \return The description.
+ */
+struct mallinfo mallinfo (void) {
+
+  struct mallinfo2 info   = mallinfo2();
+  struct mallinfo  result = {
+    .arena    = (int)info.arena,
+    .ordblks  = (int)info.ordblks,
+    .smblks   = (int)info.smblks,
+    .hblks    = (int)info.hblks,
+    .hblkhd   = (int)info.hblkhd,
+    .usmblks  = (int)info.usmblks,
+    .fsmblks  = (int)info.fsmblks,
+    .uordblks = (int)info.uordblks,
+    .fordblks = (int)info.fordblks,
+    .keepcost = (int)info.keepcost
+  };
+  return result;
+
+} // mallinfo ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Create an arena.  Its region is reserved at once, like the heap, and its
+ * descriptor placed in the region's first committed page.
+ *
+ * \param capacity The most bytes that the arena must be able to hold.
+ * \return         The new arena, if successful; `NULL` if unsuccessful.
+ */
+pb_arena_t* pb_arena_create (size_t capacity) {
+
+  intptr_t base_offset = ALIGN_UP((intptr_t)sizeof(pb_arena_t), BLOCK_ALIGN);
+  if (capacity > HEAP_SIZE) {
+    return NULL;
+  }
+
+  size_t length  = ALIGN_UP(base_offset + capacity, PAGE_SIZE);
+  void*  mapping = mmap(NULL,
+			length,
+			PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+			-1,
+			0);
+  if (mapping == MAP_FAILED) {
+    return NULL;
+  }
+
+  region_s region    = { 0 };
+  region.start_addr  = (intptr_t)mapping;
+  region.end_addr    = region.start_addr + length;
+  region.commit_addr = region.start_addr;
+  region.free_addr   = region.start_addr + base_offset;
+  if (!region_commit(&region, region.free_addr)) {
+    munmap(mapping, length);
+    return NULL;
+  }
+
+  pb_arena_t* arena = (pb_arena_t*)mapping;
+  arena->region     = region;
+  arena->base_addr  = region.free_addr;
+  return arena;
+
+} // pb_arena_create ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes from an arena by pointer bumping.  The block has no
+ * header.
+ *
+ * \param arena The arena from which to allocate.
+ * \param size  The number of bytes to allocate.
+ * \return      A pointer to the block, if successful; `NULL` if the arena is
+ *              full.
+ */
+void* pb_arena_alloc (pb_arena_t* arena, size_t size) {
+
+  if (size == 0) {
+    return NULL;
+  }
+
+  return (void*)region_reserve(&arena->region, 0, size, config.align, NULL);
+
+} // pb_arena_alloc ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes from an arena, aligned to `alignment`, by pointer
+ * bumping.  The alignment is folded into the reservation, as for the heap.
+ *
+ * \param arena     The arena from which to allocate.
+ * \param size      The number of bytes to allocate.
+ * \param alignment A power of 2.
+ * \return          A pointer to the block, if successful; `NULL` if the arena
+ *                  is full or the alignment is not a power of 2.
+ */
+void* pb_arena_alloc_aligned (pb_arena_t* arena, size_t size, size_t alignment) {
+
+  if (size == 0 || !is_power_of_2(alignment)) {
+    return NULL;
+  }
+  if (alignment < config.align) {
+    alignment = config.align;
+  }
+
+  return (void*)region_reserve(&arena->region, 0, size, alignment, NULL);
+
+} // pb_arena_alloc_aligned ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Release every block in an arena by rewinding its bump pointer to just after
+ * the descriptor.  The arena stays committed, so that it can be refilled
+ * without system calls, unless its pages are also to be released.
+ *
+ * \param arena   The arena to reset.
+ * \param release Whether to return the arena's used pages to the system.
+ */
+void pb_arena_reset (pb_arena_t* arena, bool release) {
+
+  intptr_t used_end = __atomic_exchange_n(&arena->region.free_addr, arena->base_addr,
+					  __ATOMIC_RELAXED);
+
+  if (release) {
+    intptr_t first = ALIGN_UP(arena->base_addr, PAGE_SIZE);
+    intptr_t last  = ALIGN_UP(used_end, PAGE_SIZE);
+    if (last > first) {
+      madvise((void*)first, last - first, MADV_DONTNEED);
+    }
+  }
+
+} // pb_arena_reset ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Destroy an arena, unmapping its whole region, descriptor included.
+ *
+ * \param arena The arena to destroy.
+ */
+void pb_arena_destroy (pb_arena_t* arena) {
+
+  munmap((void*)arena->region.start_addr,
+	 arena->region.end_addr - arena->region.start_addr);
+
+} // pb_arena_destroy ()
 // ==============================================================================
 
 
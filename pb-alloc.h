@@ -0,0 +1,282 @@
+// ==============================================================================
+/**
+ * pb-alloc.h
+ *
+ * The interface that the pointer-bumping allocator offers beyond the standard
+ * `malloc()` family.
+ **/
+// ==============================================================================
+
+
+
+// ==============================================================================
+// Avoid multiple inclusion.
+
+#if !defined (_PB_ALLOC_H)
+#define _PB_ALLOC_H
+// ==============================================================================
+
+
+
+// ==============================================================================
+// INCLUDES
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+// ==============================================================================
+
+
+
+// ==============================================================================
+// TYPES AND STRUCTURES
+
+/** An arena:  a region whose blocks are all released at once. */
+typedef struct pb_arena pb_arena_t;
+
+/**
+ * The number of buckets in the histogram of request sizes.  Bucket `i` counts
+ * requests for more than `2^(i-1)` and at most `2^i` bytes; the last bucket
+ * also counts anything larger.
+ */
+#define PB_SIZE_BUCKETS 40
+
+/** The allocator's activity since the process began, summed over all threads. */
+typedef struct pb_stats {
+
+  /** Calls to `malloc()` and the aligned allocators. */
+  size_t malloc_calls;
+
+  /** Calls to `calloc()`. */
+  size_t calloc_calls;
+
+  /** Calls to `realloc()`. */
+  size_t realloc_calls;
+
+  /** Calls to `free()` and its sized forms, with a non-null pointer. */
+  size_t free_calls;
+
+  /** The bytes asked for by all of those calls. */
+  size_t bytes_requested;
+
+  /**
+   * The bytes of new space taken to satisfy them, headers and padding
+   * included.  Recycled blocks take none.
+   */
+  size_t bytes_consumed;
+
+  /** The part of `bytes_consumed` taken by block headers. */
+  size_t bytes_header;
+
+  /** The part taken by padding to align blocks. */
+  size_t bytes_padding;
+
+  /**
+   * The part taken by rounding requests up:  to a size class, or to whole
+   * pages for blocks with mappings of their own.
+   */
+  size_t bytes_rounding;
+
+  /** The number of requests of each size; see `PB_SIZE_BUCKETS`. */
+  size_t size_histogram[PB_SIZE_BUCKETS];
+
+  /** Calls to `realloc()` that returned the block where it was. */
+  size_t realloc_in_place;
+
+  /** Calls to `realloc()` that moved a large block by remapping its pages. */
+  size_t realloc_remaps;
+
+  /** Calls to `realloc()` that copied the block to a new one. */
+  size_t realloc_copies;
+
+  /** How far the heap's bump pointer has advanced:  its high-water mark. */
+  size_t heap_high_water;
+
+  /** How much of the heap is committed. */
+  size_t heap_committed;
+
+  /** The bytes of freed blocks' pages returned to the system, ever. */
+  size_t bytes_purged;
+
+} pb_stats_t;
+// ==============================================================================
+
+
+
+// ==============================================================================
+// FIXED-SIZE ALLOCATION
+
+/** The largest size for which `pb_malloc_fixed()` takes its fast path. */
+#define PB_FIXED_MAX 1024
+
+/**
+ * Allocate a block of a size known at compile time, such as that of a type.
+ * The compiler resolves which path to take:  a constant size from 1 to
+ * `PB_FIXED_MAX` bytes goes to `pb_malloc_small()`, which skips the checks
+ * that `malloc()` makes of sizes, and any other size just goes to `malloc()`.
+ * The block is freed with `free()`, like any other.
+ *
+ * \param size The number of bytes to allocate.
+ * \return     A pointer to the allocated block, if successful; `NULL` if
+ *             unsuccessful.
+ */
+#define pb_malloc_fixed(size)						\
+  ((__builtin_constant_p(size) && (size) > 0 && (size) <= PB_FIXED_MAX) \
+   ? pb_malloc_small(size)						\
+   : malloc(size))
+
+/**
+ * Allocate a block of a small size, unchecked; call through
+ * `pb_malloc_fixed()`.
+ *
+ * \param size The number of bytes to allocate; at least 1 and at most
+ *             `PB_FIXED_MAX`.
+ * \return     A pointer to the allocated block, if successful; `NULL` if
+ *             unsuccessful.
+ */
+void* pb_malloc_small (size_t size);
+// ==============================================================================
+
+
+
+// ==============================================================================
+// BATCH ALLOCATION
+
+/**
+ * Allocate `count` blocks of `size` bytes at once, for about the cost of a
+ * few stores each.  Each block is freed with `free()`, like any other.
+ *
+ * \param count  The number of blocks to allocate.
+ * \param size   The number of bytes in each block.
+ * \param blocks Where to store the pointers to the blocks; room for `count`.
+ * \return       The number of blocks allocated, stored at the start of
+ *               `blocks`; fewer than `count` only if there is no more space.
+ */
+size_t pb_malloc_batch (size_t count, size_t size, void** blocks);
+// ==============================================================================
+
+
+
+// ==============================================================================
+// SIZED DEALLOCATION
+
+/**
+ * Deallocate a block whose size the caller knows, as in C23.
+ *
+ * \param ptr  A pointer to the block to be deallocated.
+ * \param size The size with which the block was allocated (or last
+ *             reallocated).
+ */
+void free_sized (void* ptr, size_t size);
+
+/**
+ * Deallocate a block whose size and alignment the caller knows, as in C23.
+ *
+ * \param ptr       A pointer to the block to be deallocated.
+ * \param alignment The alignment with which the block was allocated.
+ * \param size      The size with which the block was allocated.
+ */
+void free_aligned_sized (void* ptr, size_t alignment, size_t size);
+// ==============================================================================
+
+
+
+// ==============================================================================
+// ARENAS
+
+/**
+ * Create an arena.  Its address space is reserved at once, but committed only
+ * as it is used.
+ *
+ * \param capacity The most bytes that the arena must be able to hold.
+ * \return         The new arena, if successful; `NULL` if unsuccessful.
+ */
+pb_arena_t* pb_arena_create (size_t capacity);
+
+/**
+ * Allocate `size` bytes from an arena by pointer bumping.  The block has no
+ * header, must not be passed to `free()` or `realloc()`, and lives until the
+ * arena is reset or destroyed.  Safe to call from several threads at once.
+ *
+ * \param arena The arena from which to allocate.
+ * \param size  The number of bytes to allocate.
+ * \return      A pointer to the block, aligned as for `malloc()`, if
+ *              successful; `NULL` if the arena is full.
+ */
+void* pb_arena_alloc (pb_arena_t* arena, size_t size);
+
+/**
+ * Allocate `size` bytes from an arena, as `pb_arena_alloc()` does, but aligned
+ * to `alignment` (or to what `malloc()` guarantees, if that is more).
+ *
+ * \param arena     The arena from which to allocate.
+ * \param size      The number of bytes to allocate.
+ * \param alignment A power of 2.
+ * \return          A pointer to the block, if successful; `NULL` if the arena
+ *                  is full or the alignment is not a power of 2.
+ */
+void* pb_arena_alloc_aligned (pb_arena_t* arena, size_t size, size_t alignment);
+
+/**
+ * Release every block in an arena at once, in constant time, by rewinding its
+ * bump pointer.  Must not race with `pb_arena_alloc()` on the same arena.
+ *
+ * \param arena   The arena to reset.
+ * \param release Whether also to return the arena's pages to the system, at
+ *                the cost of faulting them in again when next used.
+ */
+void pb_arena_reset (pb_arena_t* arena, bool release);
+
+/**
+ * Destroy an arena, unmapping all of its memory.
+ *
+ * \param arena The arena to destroy.
+ */
+void pb_arena_destroy (pb_arena_t* arena);
+// ==============================================================================
+
+
+
+// ==============================================================================
+// STATISTICS
+
+/**
+ * Gather the allocator's statistics.  Each thread counts for itself, without
+ * atomic operations, so a sum taken while other threads allocate is only
+ * approximately current.
+ *
+ * \param stats Where to store the statistics.
+ */
+void pb_stats (pb_stats_t* stats);
+// ==============================================================================
+
+
+
+// ==============================================================================
+// PROFILING
+
+/**
+ * Write the samples taken by the allocation profiler, which is enabled by
+ * setting `PB_SAMPLE_INTERVAL`, to a file that pprof can read as a heap
+ * profile.  Each sample is a recent request and the stack trace that made it.
+ *
+ * \param path The file to write.
+ * \return     `true` if the profile was written; `false` if profiling is
+ *             disabled or the file could not be opened.
+ */
+bool pb_profile_dump (const char* path);
+// ==============================================================================
+
+
+
+// ==============================================================================
+#if defined (__cplusplus)
+}
+#endif
+
+#endif // _PB_ALLOC_H
+// ==============================================================================
@@ -0,0 +1,626 @@
+// ==============================================================================
+/**
+ * pb-bench.c
+ *
+ * A benchmark for whichever allocator is preloaded (or glibc's, if none is).
+ * Without arguments, it runs a set of synthetic benchmarks; given trace files
+ * recorded with `PB_TRACE` (see pb-trace.h), it replays them instead.  For
+ * each, it reports the time per operation and the page faults taken, and, at
+ * the end, the peak resident set size.  `make bench` runs it against each
+ * allocator in turn.
+ **/
+// ==============================================================================
+
+
+
+// ==============================================================================
+// INCLUDES
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "pb-trace.h"
+// ==============================================================================
+
+
+
+// ==============================================================================
+// MACRO CONSTANTS
+
+/** The number of blocks allocated by the `small` benchmark. */
+#define SMALL_BLOCKS 1000000
+
+/** The number of live blocks, and of replacements, in the `churn` benchmark. */
+#define CHURN_LIVE   4096
+#define CHURN_ROUNDS 1000000
+
+/** The number of buffers, and the growths of each, in the `realloc` benchmark. */
+#define REALLOC_BUFFERS 1000
+#define REALLOC_GROWTHS 64
+
+/** The number of producer-consumer pairs, and the blocks that each passes. */
+#define PAIRS            2
+#define PAIR_BLOCKS      500000
+
+/** The capacity of the queue between a producer and its consumer; a power of 2. */
+#define QUEUE_SIZE       1024
+
+/** The most trace files that can be replayed at once. */
+#define MAX_TRACES       256
+// ==============================================================================
+
+
+
+// ==============================================================================
+// TYPES AND STRUCTURES
+
+/** The time and faults at the start of a benchmark. */
+typedef struct measurement {
+
+  /** The monotonic clock, in nanoseconds. */
+  uint64_t start_ns;
+
+  /** The minor and major page faults taken so far by the process. */
+  long     minor_faults;
+  long     major_faults;
+
+} measurement_s;
+
+/** A queue through which one producer passes blocks to one consumer. */
+typedef struct queue {
+
+  /** The blocks in transit. */
+  void*  slots[QUEUE_SIZE];
+
+  /** The number of blocks ever pushed; written only by the producer. */
+  size_t head __attribute__ ((aligned (64)));
+
+  /** The number of blocks ever popped; written only by the consumer. */
+  size_t tail __attribute__ ((aligned (64)));
+
+} queue_s;
+
+/** A trace file, mapped for reading, and the replay's place in it. */
+typedef struct trace {
+
+  /** The file's records. */
+  const pb_trace_record_t* records;
+
+  /** The number of records, up to the first that marks the end. */
+  size_t count;
+
+  /** The index of the next record to replay. */
+  size_t next;
+
+} trace_s;
+
+/**
+ * A table from the addresses that blocks had when recorded to the blocks that
+ * stand for them in the replay.  Open addressing with linear probing; a
+ * replaced block leaves a tombstone.
+ */
+typedef struct block_map {
+
+  /** The recorded addresses; `0` for an empty slot, `1` for a tombstone. */
+  uint64_t* keys;
+
+  /** The replay's blocks. */
+  void**    values;
+
+  /** The number of slots; a power of 2. */
+  size_t    size;
+
+} block_map_s;
+// ==============================================================================
+
+
+
+// ==============================================================================
+// GLOBALS
+
+/** The state of the pseudo-random number generator. */
+static uint64_t random_state = 0x123456789abcdefULL;
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Draw a pseudo-random number (xorshift64*).
+ *
+ * \param limit One more than the largest number to draw.
+ * \return      A number in `[0, limit)`.
+ */
+static uint64_t draw (uint64_t limit) {
+
+  random_state ^= random_state >> 12;
+  random_state ^= random_state << 25;
+  random_state ^= random_state >> 27;
+  return (random_state * 0x2545f4914f6cdd1dULL) % limit;
+
+} // draw ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/** Read the monotonic clock, in nanoseconds. */
+static uint64_t now_ns () {
+
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+
+} // now_ns ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Start measuring a benchmark.
+ *
+ * \param measurement Where to keep the starting time and faults.
+ */
+static void start (measurement_s* measurement) {
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  measurement->minor_faults = usage.ru_minflt;
+  measurement->major_faults = usage.ru_majflt;
+  measurement->start_ns     = now_ns();
+
+} // start ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Finish measuring a benchmark, and report the results.
+ *
+ * \param measurement The starting time and faults.
+ * \param name        The name of the benchmark.
+ * \param ops         The number of operations that it performed.
+ */
+static void finish (measurement_s* measurement, const char* name, uint64_t ops) {
+
+  uint64_t      elapsed_ns = now_ns() - measurement->start_ns;
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  printf("%-12s %12lu %10.1f %14ld %14ld\n",
+	 name,
+	 (unsigned long)ops,
+	 ops == 0 ? 0.0 : (double)elapsed_ns / ops,
+	 usage.ru_minflt - measurement->minor_faults,
+	 usage.ru_majflt - measurement->major_faults);
+
+} // finish ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Many small allocations:  allocate a million blocks of 16 to 256 bytes,
+ * touching each, and then free them all.
+ */
+static void bench_small () {
+
+  void**        blocks = malloc(SMALL_BLOCKS * sizeof(void*));
+  measurement_s measurement;
+
+  start(&measurement);
+  for (int i = 0; i < SMALL_BLOCKS; i += 1) {
+    blocks[i] = malloc(16 + draw(241));
+    *(char*)blocks[i] = (char)i;
+  }
+  for (int i = 0; i < SMALL_BLOCKS; i += 1) {
+    free(blocks[i]);
+  }
+  finish(&measurement, "small", 2 * SMALL_BLOCKS);
+
+  free(blocks);
+
+} // bench_small ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Steady churn:  keep a few thousand blocks of 8 to 512 bytes live, and
+ * repeatedly replace a random one with a new block.
+ */
+static void bench_churn () {
+
+  void*         blocks[CHURN_LIVE];
+  measurement_s measurement;
+  for (int i = 0; i < CHURN_LIVE; i += 1) {
+    blocks[i] = malloc(8 + draw(505));
+  }
+
+  start(&measurement);
+  for (int round = 0; round < CHURN_ROUNDS; round += 1) {
+    int victim = draw(CHURN_LIVE);
+    free(blocks[victim]);
+    blocks[victim] = malloc(8 + draw(505));
+    *(char*)blocks[victim] = (char)round;
+  }
+  finish(&measurement, "churn", 2 * CHURN_ROUNDS);
+
+  for (int i = 0; i < CHURN_LIVE; i += 1) {
+    free(blocks[i]);
+  }
+
+} // bench_churn ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Realloc growth:  grow a thousand buffers by 64 bytes at a time, in turn, as
+ * growing arrays and strings do, so that each is rarely the latest block.
+ */
+static void bench_realloc () {
+
+  char*         buffers[REALLOC_BUFFERS] = { NULL };
+  measurement_s measurement;
+
+  start(&measurement);
+  for (int growth = 1; growth <= REALLOC_GROWTHS; growth += 1) {
+    for (int i = 0; i < REALLOC_BUFFERS; i += 1) {
+      buffers[i] = realloc(buffers[i], (size_t)growth * 64);
+      buffers[i][(size_t)growth * 64 - 1] = (char)growth;
+    }
+  }
+  for (int i = 0; i < REALLOC_BUFFERS; i += 1) {
+    free(buffers[i]);
+  }
+  finish(&measurement, "realloc", (uint64_t)REALLOC_BUFFERS * (REALLOC_GROWTHS + 1));
+
+} // bench_realloc ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * A producer:  allocate blocks of 16 to 1024 bytes and pass them to the
+ * consumer, waiting whenever the queue is full.
+ *
+ * \param arg The queue to the consumer.
+ */
+static void* produce (void* arg) {
+
+  queue_s* queue = (queue_s*)arg;
+  uint64_t state = (uintptr_t)arg | 1;
+  for (size_t block = 0; block < PAIR_BLOCKS; block += 1) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    char* ptr = malloc(16 + state % 1009);
+    *ptr = (char)block;
+
+    while (block - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) >= QUEUE_SIZE) {
+      sched_yield();
+    }
+    queue->slots[block & (QUEUE_SIZE - 1)] = ptr;
+    __atomic_store_n(&queue->head, block + 1, __ATOMIC_RELEASE);
+  }
+
+  return NULL;
+
+} // produce ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * A consumer:  free each block that the producer passes, waiting whenever the
+ * queue is empty.
+ *
+ * \param arg The queue from the producer.
+ */
+static void* consume (void* arg) {
+
+  queue_s* queue = (queue_s*)arg;
+  for (size_t block = 0; block < PAIR_BLOCKS; block += 1) {
+    while (__atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) == block) {
+      sched_yield();
+    }
+    free(queue->slots[block & (QUEUE_SIZE - 1)]);
+    __atomic_store_n(&queue->tail, block + 1, __ATOMIC_RELEASE);
+  }
+
+  return NULL;
+
+} // consume ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Producer-consumer:  pairs of threads, each block allocated by one thread
+ * of a pair and freed by the other.
+ */
+static void bench_producer_consumer () {
+
+  static queue_s queues[PAIRS];
+  pthread_t      producers[PAIRS];
+  pthread_t      consumers[PAIRS];
+  measurement_s  measurement;
+
+  start(&measurement);
+  for (int pair = 0; pair < PAIRS; pair += 1) {
+    pthread_create(&producers[pair], NULL, produce, &queues[pair]);
+    pthread_create(&consumers[pair], NULL, consume, &queues[pair]);
+  }
+  for (int pair = 0; pair < PAIRS; pair += 1) {
+    pthread_join(producers[pair], NULL);
+    pthread_join(consumers[pair], NULL);
+  }
+  finish(&measurement, "prodcons", (uint64_t)2 * PAIRS * PAIR_BLOCKS);
+
+} // bench_producer_consumer ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/** Find the slot for a recorded address, or the empty slot where it belongs. */
+static size_t block_map_find (block_map_s* map, uint64_t key, bool inserting) {
+
+  size_t slot = (key * 0x9e3779b97f4a7c15ULL >> 20) & (map->size - 1);
+  while (map->keys[slot] != 0 && map->keys[slot] != key &&
+	 !(inserting && map->keys[slot] == 1)) {
+    slot = (slot + 1) & (map->size - 1);
+  }
+  return slot;
+
+} // block_map_find ()
+
+/** Take the block that stands for a recorded address out of the table. */
+static void* block_map_remove (block_map_s* map, uint64_t key) {
+
+  if (key <= 1) {
+    return NULL;
+  }
+  size_t slot = block_map_find(map, key, false);
+  if (map->keys[slot] != key) {
+    return NULL;
+  }
+  map->keys[slot] = 1;
+  return map->values[slot];
+
+} // block_map_remove ()
+
+/** Record the block that stands for a recorded address. */
+static void block_map_insert (block_map_s* map, uint64_t key, void* value) {
+
+  if (key <= 1 || value == NULL) {
+    return;
+  }
+  size_t slot = block_map_find(map, key, true);
+  map->keys[slot]   = key;
+  map->values[slot] = value;
+
+} // block_map_insert ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Map a trace file for reading.
+ *
+ * \param path  The file.
+ * \param trace Where to describe the trace.
+ * \return      `true` if the file is a trace; `false` otherwise.
+ */
+static bool trace_open (const char* path, trace_s* trace) {
+
+  int         fd = open(path, O_RDONLY);
+  struct stat status;
+  if (fd < 0 || fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(pb_trace_header_t)) {
+    fprintf(stderr, "pb-bench: cannot read %s\n", path);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+
+  void* mapping = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    fprintf(stderr, "pb-bench: cannot read %s\n", path);
+    return false;
+  }
+  const pb_trace_header_t* header = (const pb_trace_header_t*)mapping;
+  if (memcmp(header->magic, PB_TRACE_MAGIC, sizeof(header->magic)) != 0 ||
+      header->record_size != sizeof(pb_trace_record_t)) {
+    fprintf(stderr, "pb-bench: %s is not a trace\n", path);
+    munmap(mapping, status.st_size);
+    return false;
+  }
+
+  trace->records = (const pb_trace_record_t*)(header + 1);
+  trace->next    = 0;
+  trace->count   = (status.st_size - sizeof(pb_trace_header_t)) / sizeof(pb_trace_record_t);
+  for (size_t i = 0; i < trace->count; i += 1) {
+    if (trace->records[i].op == PB_TRACE_NONE) {
+      trace->count = i;
+    }
+  }
+  return true;
+
+} // trace_open ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Determine whether `posix_memalign()` comes from the same library as
+ * `malloc()`.  If not, the blocks that it returns are from another heap,
+ * which the allocator under test could not free.
+ *
+ * \return `true` if aligned blocks can be replayed; `false` otherwise.
+ */
+static bool aligned_supported () {
+
+  Dl_info malloc_info;
+  Dl_info aligned_info;
+  if (dladdr((void*)malloc, &malloc_info) == 0 || dladdr((void*)posix_memalign, &aligned_info) == 0) {
+    return true;
+  }
+  return malloc_info.dli_fbase == aligned_info.dli_fbase;
+
+} // aligned_supported ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Replay trace files, in one thread, in the order of their timestamps.  If
+ * the allocator under test does not provide aligned allocation, aligned
+ * records are replayed with `malloc()` instead, and a note says how many.
+ *
+ * \param count The number of files.
+ * \param paths The files.
+ * \return      `true` if every file could be replayed; `false` otherwise.
+ */
+static bool bench_replay (int count, char** paths) {
+
+  static trace_s traces[MAX_TRACES];
+  size_t         total = 0;
+  if (count > MAX_TRACES) {
+    count = MAX_TRACES;
+  }
+  for (int i = 0; i < count; i += 1) {
+    if (!trace_open(paths[i], &traces[i])) {
+      return false;
+    }
+    total += traces[i].count;
+  }
+
+  // A table with room for every block in the traces, live at once.
+  block_map_s map;
+  for (map.size = 1024; map.size < 2 * total; map.size *= 2);
+  map.keys   = mmap(NULL, map.size * sizeof(uint64_t), PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  map.values = mmap(NULL, map.size * sizeof(void*), PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map.keys == MAP_FAILED || map.values == MAP_FAILED) {
+    fprintf(stderr, "pb-bench: no room to replay\n");
+    return false;
+  }
+
+  bool          aligned  = aligned_supported();
+  size_t        degraded = 0;
+  measurement_s measurement;
+  start(&measurement);
+  for (size_t replayed = 0; replayed < total; replayed += 1) {
+
+    // The earliest record not yet replayed, from any of the traces.
+    trace_s* earliest = NULL;
+    for (int i = 0; i < count; i += 1) {
+      if (traces[i].next < traces[i].count &&
+	  (earliest == NULL ||
+	   traces[i].records[traces[i].next].tsc < earliest->records[earliest->next].tsc)) {
+	earliest = &traces[i];
+      }
+    }
+    const pb_trace_record_t* record = &earliest->records[earliest->next++];
+
+    char* block = NULL;
+    switch (record->op) {
+    case PB_TRACE_MALLOC:
+      block = malloc(record->size);
+      break;
+    case PB_TRACE_CALLOC:
+      block = calloc(1, record->size);
+      break;
+    case PB_TRACE_REALLOC:
+      block = realloc(block_map_remove(&map, record->old_ptr), record->size);
+      break;
+    case PB_TRACE_ALIGNED:
+      if (!aligned) {
+	block     = malloc(record->size);
+	degraded += 1;
+      } else if (posix_memalign((void**)&block, record->align, record->size) != 0) {
+	block = NULL;
+      }
+      break;
+    case PB_TRACE_FREE:
+      free(block_map_remove(&map, record->ptr));
+      break;
+    }
+    if (block != NULL && record->size > 0) {
+      *block = 1;
+      block_map_insert(&map, record->ptr, block);
+    }
+
+  }
+  finish(&measurement, "replay", total);
+  if (degraded > 0) {
+    printf("note: no aligned allocation; %zu aligned records replayed with malloc()\n", degraded);
+  }
+
+  return true;
+
+} // bench_replay ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Run the synthetic benchmarks, or replay the given traces.
+ *
+ * \param argc The number of arguments.
+ * \param argv The trace files to replay, if any.
+ */
+int main (int argc, char** argv) {
+
+  const char* allocator = getenv("LD_PRELOAD");
+  printf("allocator: %s\n", (allocator == NULL || *allocator == '\0') ? "glibc" : allocator);
+  printf("%-12s %12s %10s %14s %14s\n", "benchmark", "ops", "ns/op", "minor faults", "major faults");
+
+  if (argc > 1) {
+    if (!bench_replay(argc - 1, argv + 1)) {
+      return 1;
+    }
+  } else {
+    bench_small();
+    bench_churn();
+    bench_realloc();
+    bench_producer_consumer();
+  }
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  printf("peak RSS: %ld KB\n\n", usage.ru_maxrss);
+  return 0;
+
+} // main ()
+// ==============================================================================
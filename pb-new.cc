@@ -0,0 +1,203 @@
+// ==============================================================================
+/**
+ * pb-new.cc
+ *
+ * C++ allocation through the pointer-bumping allocator:  replacements for
+ * every form of `operator new` and `operator delete`, linked with pb-alloc.c
+ * into libpbxx.so.  Each goes straight to the allocator's entry points,
+ * rather than through libstdc++'s own `operator new`, and the sized forms of
+ * `operator delete` pass their sizes on to `free_sized()`.
+ *
+ * As the standard requires, a request that cannot be met calls the new
+ * handler, if one is installed, and tries again; without one, it throws
+ * `std::bad_alloc`, or returns `nullptr` from the `nothrow` forms.
+ **/
+// ==============================================================================
+
+
+
+// ==============================================================================
+// INCLUDES
+
+#include <cstdlib>
+#include <new>
+
+#include "pb-alloc.h"
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate a block for `operator new`.  Sizes that `pb_malloc_fixed()` would
+ * take its fast path for go to `pb_malloc_small()`; the compiler seldom knows
+ * the size here, but the check is cheaper than `malloc()`'s.
+ *
+ * \param size  The number of bytes to allocate; `0` gets a block of its own,
+ *              as for any other size.
+ * \param align The alignment of the block; `0` for what `malloc()` gives.
+ * \return      A pointer to the allocated block, if successful; `nullptr` if
+ *              unsuccessful.
+ */
+static inline void* new_block (std::size_t size, std::size_t align) {
+
+  if (size == 0) {
+    size = 1;
+  }
+  if (align != 0) {
+    return aligned_alloc(align, size);
+  }
+  return (size <= PB_FIXED_MAX) ? pb_malloc_small(size) : malloc(size);
+
+} // new_block ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate a block for a throwing `operator new`, calling the new handler
+ * until the request can be met.
+ *
+ * \param size  The number of bytes to allocate.
+ * \param align The alignment of the block; `0` for what `malloc()` gives.
+ * \return      A pointer to the allocated block.  **Throws** `std::bad_alloc`
+ *              if unsuccessful and no new handler is installed.
+ */
+static void* new_or_throw (std::size_t size, std::size_t align) {
+
+  for (;;) {
+    void* block_ptr = new_block(size, align);
+    if (block_ptr != nullptr) {
+      return block_ptr;
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+
+} // new_or_throw ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate a block for a `nothrow` `operator new`, calling the new handler
+ * until the request can be met.
+ *
+ * \param size  The number of bytes to allocate.
+ * \param align The alignment of the block; `0` for what `malloc()` gives.
+ * \return      A pointer to the allocated block, if successful; `nullptr` if
+ *              unsuccessful, or if the new handler throws.
+ */
+static void* new_or_null (std::size_t size, std::size_t align) noexcept {
+
+  try {
+    return new_or_throw(size, align);
+  } catch (...) {
+    return nullptr;
+  }
+
+} // new_or_null ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+// OPERATOR NEW
+
+void* operator new (std::size_t size) {
+  void* block_ptr = new_block(size, 0);
+  return (__builtin_expect(block_ptr != nullptr, true)) ? block_ptr : new_or_throw(size, 0);
+}
+
+void* operator new[] (std::size_t size) {
+  void* block_ptr = new_block(size, 0);
+  return (__builtin_expect(block_ptr != nullptr, true)) ? block_ptr : new_or_throw(size, 0);
+}
+
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept {
+  void* block_ptr = new_block(size, 0);
+  return (__builtin_expect(block_ptr != nullptr, true)) ? block_ptr : new_or_null(size, 0);
+}
+
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept {
+  void* block_ptr = new_block(size, 0);
+  return (__builtin_expect(block_ptr != nullptr, true)) ? block_ptr : new_or_null(size, 0);
+}
+
+void* operator new (std::size_t size, std::align_val_t align) {
+  return new_or_throw(size, static_cast<std::size_t>(align));
+}
+
+void* operator new[] (std::size_t size, std::align_val_t align) {
+  return new_or_throw(size, static_cast<std::size_t>(align));
+}
+
+void* operator new (std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+  return new_or_null(size, static_cast<std::size_t>(align));
+}
+
+void* operator new[] (std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+  return new_or_null(size, static_cast<std::size_t>(align));
+}
+// ==============================================================================
+
+
+
+// ==============================================================================
+// OPERATOR DELETE
+//
+// A block of size 0 was allocated with 1 byte, so that is the size passed on.
+
+void operator delete (void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[] (void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete (void* ptr, const std::nothrow_t&) noexcept {
+  free(ptr);
+}
+
+void operator delete[] (void* ptr, const std::nothrow_t&) noexcept {
+  free(ptr);
+}
+
+void operator delete (void* ptr, std::size_t size) noexcept {
+  free_sized(ptr, (size == 0) ? 1 : size);
+}
+
+void operator delete[] (void* ptr, std::size_t size) noexcept {
+  free_sized(ptr, (size == 0) ? 1 : size);
+}
+
+void operator delete (void* ptr, std::align_val_t) noexcept {
+  free(ptr);
+}
+
+void operator delete[] (void* ptr, std::align_val_t) noexcept {
+  free(ptr);
+}
+
+void operator delete (void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+  free(ptr);
+}
+
+void operator delete[] (void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+  free(ptr);
+}
+
+void operator delete (void* ptr, std::size_t size, std::align_val_t align) noexcept {
+  free_aligned_sized(ptr, static_cast<std::size_t>(align), (size == 0) ? 1 : size);
+}
+
+void operator delete[] (void* ptr, std::size_t size, std::align_val_t align) noexcept {
+  free_aligned_sized(ptr, static_cast<std::size_t>(align), (size == 0) ? 1 : size);
+}
+// ==============================================================================
@@ -0,0 +1,274 @@
+// ==============================================================================
+/**
+ * pb-pmr.h
+ *
+ * Polymorphic memory resources (`std::pmr::memory_resource`) over the
+ * pointer-bumping allocator's arenas, so that standard containers can bump
+ * their storage from an arena:
+ *
+ *   pb::arena_resource     One arena of a fixed capacity.
+ *   pb::monotonic_resource A chain of arenas that grows as it fills, like
+ *                          `std::pmr::monotonic_buffer_resource`.
+ *
+ * Deallocation does nothing; memory comes back only all at once, through
+ * `release()` or the resource's destruction.  Requires C++17, and either
+ * libpb.so or libpbxx.so.
+ **/
+// ==============================================================================
+
+
+
+// ==============================================================================
+// Avoid multiple inclusion.
+
+#if !defined (_PB_PMR_H)
+#define _PB_PMR_H
+// ==============================================================================
+
+
+
+// ==============================================================================
+// INCLUDES
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+
+#include "pb-alloc.h"
+// ==============================================================================
+
+
+
+namespace pb {
+
+// ==============================================================================
+/**
+ * A memory resource that bumps every block from a single arena.  Its whole
+ * capacity is reserved up front but committed only as it is used, so a
+ * generous capacity costs little.  Safe to allocate from several threads at
+ * once, as the arena is; `release()` must not race with allocation.
+ */
+class arena_resource : public std::pmr::memory_resource {
+
+public:
+
+  /**
+   * Create the resource and its arena.
+   *
+   * \param capacity The most bytes that the resource must be able to hold.
+   *                 **Throws** `std::bad_alloc` if the arena cannot be
+   *                 created.
+   */
+  explicit arena_resource (std::size_t capacity)
+    : arena_(pb_arena_create(capacity)) {
+    if (arena_ == nullptr) {
+      throw std::bad_alloc();
+    }
+  }
+
+  arena_resource (const arena_resource&) = delete;
+  arena_resource& operator= (const arena_resource&) = delete;
+
+  /** Destroy the arena, and with it every block allocated from it. */
+  ~arena_resource () override {
+    pb_arena_destroy(arena_);
+  }
+
+  /**
+   * Free every block at once.
+   *
+   * \param purge Whether also to return the arena's pages to the system.
+   */
+  void release (bool purge = false) noexcept {
+    pb_arena_reset(arena_, purge);
+  }
+
+protected:
+
+  /** Bump a block from the arena; **throws** `std::bad_alloc` if it is full. */
+  void* do_allocate (std::size_t bytes, std::size_t alignment) override {
+    void* block_ptr = pb_arena_alloc_aligned(arena_, (bytes == 0) ? 1 : bytes, alignment);
+    if (block_ptr == nullptr) {
+      throw std::bad_alloc();
+    }
+    return block_ptr;
+  }
+
+  /** Do nothing:  blocks are only ever freed all at once. */
+  void do_deallocate (void*, std::size_t, std::size_t) override {
+  }
+
+  /** Only the same resource can free another's blocks. */
+  bool do_is_equal (const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+private:
+
+  /** The arena from which every block is bumped. */
+  pb_arena_t* arena_;
+
+}; // class arena_resource
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * A memory resource that bumps every block from the newest of a chain of
+ * arenas.  When that arena fills, the resource adds one with twice its
+ * capacity (or more, for a larger block).  Not safe to use from several
+ * threads at once, like `std::pmr::monotonic_buffer_resource`.
+ */
+class monotonic_resource : public std::pmr::memory_resource {
+
+public:
+
+  /**
+   * Create the resource and its first arena.
+   *
+   * \param initial_capacity The capacity of the first arena.  **Throws**
+   *                         `std::bad_alloc` if it cannot be created.
+   */
+  explicit monotonic_resource (std::size_t initial_capacity = 1 << 20)
+    : first_(pb_arena_create(initial_capacity)),
+      current_(first_),
+      added_(nullptr),
+      initial_capacity_(initial_capacity),
+      next_capacity_(2 * initial_capacity) {
+    if (first_ == nullptr) {
+      throw std::bad_alloc();
+    }
+  }
+
+  monotonic_resource (const monotonic_resource&) = delete;
+  monotonic_resource& operator= (const monotonic_resource&) = delete;
+
+  /** Destroy every arena, and with them every block allocated from them. */
+  ~monotonic_resource () override {
+    release_added();
+    pb_arena_destroy(first_);
+  }
+
+  /**
+   * Free every block at once, keeping only the first arena.
+   *
+   * \param purge Whether also to return the first arena's pages to the
+   *              system.
+   */
+  void release (bool purge = false) noexcept {
+    release_added();
+    pb_arena_reset(first_, purge);
+    current_       = first_;
+    next_capacity_ = 2 * initial_capacity_;
+  }
+
+protected:
+
+  /**
+   * Bump a block from the newest arena, adding an arena if that one is full;
+   * **throws** `std::bad_alloc` if none can be added.
+   */
+  void* do_allocate (std::size_t bytes, std::size_t alignment) override {
+    if (bytes == 0) {
+      bytes = 1;
+    }
+    void* block_ptr = pb_arena_alloc_aligned(current_, bytes, alignment);
+    if (block_ptr == nullptr) {
+      block_ptr = allocate_in_new_arena(bytes, alignment);
+    }
+    return block_ptr;
+  }
+
+  /** Do nothing:  blocks are only ever freed all at once. */
+  void do_deallocate (void*, std::size_t, std::size_t) override {
+  }
+
+  /** Only the same resource can free another's blocks. */
+  bool do_is_equal (const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+private:
+
+  /**
+   * The first block of each arena after the first, which records the arena
+   * and links it to the one added before it.
+   */
+  struct link {
+    pb_arena_t* arena;
+    link*       previous;
+  };
+
+  /**
+   * Add an arena large enough for a block and link it into the chain, then
+   * bump the block from it; **throws** `std::bad_alloc` if the block is too
+   * large for any arena.
+   */
+  void* allocate_in_new_arena (std::size_t bytes, std::size_t alignment) {
+    if (alignment > SIZE_MAX - sizeof(link) || bytes > SIZE_MAX - sizeof(link) - alignment) {
+      throw std::bad_alloc();
+    }
+    std::size_t needed   = sizeof(link) + alignment + bytes;
+    std::size_t capacity = (next_capacity_ == 0) ? needed : next_capacity_;
+    while (capacity < needed) {
+      if (capacity > SIZE_MAX / 2) {
+	throw std::bad_alloc();
+      }
+      capacity *= 2;
+    }
+
+    pb_arena_t* arena = pb_arena_create(capacity);
+    if (arena == nullptr) {
+      throw std::bad_alloc();
+    }
+    link* head     = static_cast<link*>(pb_arena_alloc(arena, sizeof(link)));
+    head->arena    = arena;
+    head->previous = added_;
+
+    added_         = head;
+    current_       = arena;
+    next_capacity_ = (capacity > SIZE_MAX / 2) ? capacity : 2 * capacity;
+
+    void* block_ptr = pb_arena_alloc_aligned(arena, bytes, alignment);
+    if (block_ptr == nullptr) {
+      throw std::bad_alloc();
+    }
+    return block_ptr;
+  }
+
+  /** Destroy every arena after the first. */
+  void release_added () noexcept {
+    while (added_ != nullptr) {
+      link* previous = added_->previous;
+      pb_arena_destroy(added_->arena);
+      added_ = previous;
+    }
+  }
+
+  /** The arena from which the resource started. */
+  pb_arena_t* first_;
+
+  /** The newest arena, from which blocks are bumped. */
+  pb_arena_t* current_;
+
+  /** The link at the head of the newest arena after the first, if any. */
+  link*       added_;
+
+  /** The capacity of the first arena. */
+  std::size_t initial_capacity_;
+
+  /** The least capacity of the next arena to be added. */
+  std::size_t next_capacity_;
+
+}; // class monotonic_resource
+// ==============================================================================
+
+} // namespace pb
+
+
+
+// ==============================================================================
+#endif // _PB_PMR_H
+// ==============================================================================
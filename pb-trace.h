@@ -0,0 +1,102 @@
+// ==============================================================================
+/**
+ * pb-trace.h
+ *
+ * The format of allocation traces:  recorded by pb-alloc.c (with `PB_TRACE`
+ * set), and replayed by pb-bench.c.
+ *
+ * A trace file is a `pb_trace_header_t` followed by records, each
+ * `record_size` bytes long, in the order that one thread made its calls.  A
+ * record whose `op` is `PB_TRACE_NONE` marks the end of the trace, so that a
+ * file may be extended ahead of its records.  A process leaves one file per
+ * thread, and the records of all of them merge into one order through their
+ * timestamps.
+ **/
+// ==============================================================================
+
+
+
+// ==============================================================================
+// Avoid multiple inclusion.
+
+#if !defined (_PB_TRACE_H)
+#define _PB_TRACE_H
+// ==============================================================================
+
+
+
+// ==============================================================================
+// INCLUDES
+
+#include <stdint.h>
+// ==============================================================================
+
+
+
+// ==============================================================================
+// MACRO CONSTANTS
+
+/** The first bytes of every trace file:  "PBTRACE" and a version digit. */
+#define PB_TRACE_MAGIC   "PBTRACE1"
+
+/** The operations that a record may describe. */
+#define PB_TRACE_NONE    0
+#define PB_TRACE_MALLOC  1
+#define PB_TRACE_CALLOC  2
+#define PB_TRACE_REALLOC 3
+#define PB_TRACE_FREE    4
+#define PB_TRACE_ALIGNED 5
+// ==============================================================================
+
+
+
+// ==============================================================================
+// TYPES AND STRUCTURES
+
+/** The beginning of a trace file. */
+typedef struct pb_trace_header {
+
+  /** `PB_TRACE_MAGIC`, without its terminating null. */
+  char     magic[8];
+
+  /** The size of each record that follows. */
+  uint32_t record_size;
+
+  /** The recording thread's number, counting from 1 in each process. */
+  uint32_t thread;
+
+} pb_trace_header_t;
+
+/** One call to the allocator. */
+typedef struct pb_trace_record {
+
+  /** The processor's timestamp counter when the call returned. */
+  uint64_t tsc;
+
+  /** The number of bytes requested:  the total, for `calloc()`. */
+  uint64_t size;
+
+  /**
+   * The block returned (or, for `free()`, the block freed), as its address.
+   * Addresses identify blocks only while they are live; a replay maps each to
+   * a block of its own.
+   */
+  uint64_t ptr;
+
+  /** For `realloc()`, the block passed in; otherwise `0`. */
+  uint64_t old_ptr;
+
+  /** The alignment requested, for `PB_TRACE_ALIGNED`; otherwise `0`. */
+  uint32_t align;
+
+  /** One of the `PB_TRACE_` operations. */
+  uint32_t op;
+
+} pb_trace_record_t;
+// ==============================================================================
+
+
+
+// ==============================================================================
+#endif // _PB_TRACE_H
+// ==============================================================================
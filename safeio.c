@@ -11,13 +11,14 @@
 // ==============================================================================
 // INCLUDES
 
-#include <stdarg.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
 
 #include "safeio.h"
 // ==============================================================================
@@ -39,6 +40,18 @@
 /** The maximum length of debugging/error messages. */
 #define MAX_MESSAGE_LENGTH 256
 
+/** The most integers appended to a message; any more are dropped. */
+#define MAX_ARGS 16
+
+/**
+ * The maximum length of a whole line of output:  a prefix, a message, and its
+ * integers, each tab-separated with up to 20 digits.
+ */
+#define MAX_RECORD_LENGTH (2 * MAX_MESSAGE_LENGTH + MAX_ARGS * 21)
+
+/** The size of each thread's buffer of lines not yet written. */
+#define LOG_BUFFER_SIZE 4096
+
 #define TAB_STRING "\t"
 #define TAB_LENGTH 1
 
@@ -46,6 +59,48 @@
 #define NEWLINE_LENGTH 1
 
 #define OUTPUT_FD  STDERR_FILENO
+
+/** Storage class for per-thread state; see pb-alloc.c. */
+#define THREAD_LOCAL __thread __attribute__ ((tls_model ("initial-exec")))
+// ==============================================================================
+
+
+
+// ==============================================================================
+// TYPES AND STRUCTURES
+
+/** A thread's buffer of lines not yet written. */
+typedef struct log_buffer {
+
+  /** The number of bytes in the buffer. */
+  size_t length;
+
+  /** The lines themselves. */
+  char   bytes[LOG_BUFFER_SIZE - sizeof(size_t)];
+
+} log_buffer_s;
+// ==============================================================================
+
+
+
+// ==============================================================================
+// GLOBALS
+
+/**
+ * The calling thread's buffer, mapped on its first message.  Only a pointer is
+ * thread-local, so as not to crowd the static TLS block.
+ */
+static THREAD_LOCAL log_buffer_s* log_buffer = NULL;
+
+/** Whether the calling thread is exiting, so that its lines go straight out. */
+static THREAD_LOCAL bool log_unbuffered = false;
+
+/** Whether the process is exiting, so that every line goes straight out. */
+static bool log_exiting = false;
+
+/** Releases a thread's buffer when the thread exits. */
+static pthread_key_t  log_key;
+static pthread_once_t log_key_once = PTHREAD_ONCE_INIT;
 // ==============================================================================
 
 
@@ -77,58 +132,196 @@ int_to_hex (char* buffer, uint64_t value) {
 
 
 
+// ==============================================================================
+void
+int_to_dec (char* buffer, uint64_t value) {
+
+  char  digits[24];
+  char* current = &digits[sizeof(digits) - 1];
+  *current = '\0';
+  do {
+    *--current = '0' + (value % 10);
+    value     /= 10;
+  } while (value != 0);
+
+  strcpy(buffer, current);
+
+} // int_to_dec ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Write a batch of buffered lines and one more line, with a single system call
+ * (as long as the output accepts everything at once).
+ *
+ * \param batch        The buffered lines.
+ * \param batch_length The number of bytes in `batch`.
+ * \param line         The line to follow them.
+ * \param line_length  The number of bytes in `line`.
+ */
+static void
+write_out (const char* batch, size_t batch_length, const char* line, size_t line_length) {
+
+  struct iovec parts[2] = { { (void*)batch, batch_length },
+			    { (void*)line,  line_length  } };
+  struct iovec* part  = parts;
+  int           count = 2;
+  while (count > 0) {
+    ssize_t written = writev(OUTPUT_FD, part, count);
+    if (written < 0) {
+      return;
+    }
+    while (count > 0 && (size_t)written >= part->iov_len) {
+      written -= part->iov_len;
+      part    += 1;
+      count   -= 1;
+    }
+    if (count > 0) {
+      part->iov_base  = (char*)part->iov_base + written;
+      part->iov_len  -= written;
+    }
+  }
+
+} // write_out ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Flush and unmap an exiting thread's buffer.  Any lines that the thread emits
+ * later in its exit are written at once.
+ *
+ * \param buffer The thread's buffer.
+ */
+static void
+log_release (void* buffer) {
+
+  safe_flush();
+  log_buffer     = NULL;
+  log_unbuffered = true;
+  munmap(buffer, sizeof(log_buffer_s));
+
+} // log_release ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/** Create the key through which exiting threads release their buffers. */
+static void
+log_key_create () {
+
+  pthread_key_create(&log_key, log_release);
+
+} // log_key_create ()
+// ==============================================================================
+
+
+
 // ==============================================================================
 /**
- * Print a message.
+ * Find the calling thread's buffer, mapping one if it has none yet.
+ *
+ * \return The buffer; `NULL` if lines must be written at once.
+ */
+static log_buffer_s*
+get_buffer () {
+
+  if (log_buffer != NULL || log_unbuffered || log_exiting) {
+    return log_buffer;
+  }
+
+  void* mapping = mmap(NULL,
+		       sizeof(log_buffer_s),
+		       PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS,
+		       -1,
+		       0);
+  if (mapping == MAP_FAILED) {
+    log_unbuffered = true;
+    return NULL;
+  }
+
+  pthread_once(&log_key_once, log_key_create);
+  log_buffer = (log_buffer_s*)mapping;
+  pthread_setspecific(log_key, log_buffer);
+  return log_buffer;
+
+} // get_buffer ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Print a message.  The line is added to the calling thread's buffer, which is
+ * written first (together with the line) if the line does not fit.
  *
  * \param prefix The string to emit as a prefix.
  * \param msg    The string to emit as a message.
- * \param argc   Count of the variadic arguments.
- * \param argp   The variadic arguments of integers to be appended to the output.
+ * \param argc   Count of the integers in `argv`.
+ * \param argv   The integers to be appended to the output.
+ * \param hex    Whether to write the integers in hexadecimal, or else decimal.
+ * \param urgent Whether to write the line, and everything before it, at once.
  */
-void
-emit (const char* prefix, const char* msg, int argc, va_list argp) {
-  
-  // Emit the prefix and message.
-  write(OUTPUT_FD, prefix, strnlen(prefix, MAX_MESSAGE_LENGTH));
-  write(OUTPUT_FD, msg,    strnlen(msg,    MAX_MESSAGE_LENGTH));
-
-  // Emit each given integer with a tab prefix.
-  for (int i = 0; i < argc; ++i) {
-    uint64_t value = va_arg(argp, uint64_t);
-    char     buffer[MAX_MESSAGE_LENGTH];
-    int_to_hex(buffer, value);
-    write(OUTPUT_FD, TAB_STRING, TAB_LENGTH);
-    write(OUTPUT_FD, buffer,     strnlen(buffer, MAX_MESSAGE_LENGTH));
+static void
+emit (const char* prefix, const char* msg, int argc, const uint64_t* argv, bool hex, bool urgent) {
+
+  // Lay out the whole line:  the prefix, the message, each given integer with
+  // a tab prefix, and a newline.
+  char   line[MAX_RECORD_LENGTH];
+  size_t length = strnlen(prefix, MAX_MESSAGE_LENGTH);
+  memcpy(line, prefix, length);
+  size_t msg_length = strnlen(msg, MAX_MESSAGE_LENGTH);
+  memcpy(line + length, msg, msg_length);
+  length += msg_length;
+  for (int i = 0; i < argc && i < MAX_ARGS; ++i) {
+    memcpy(line + length, TAB_STRING, TAB_LENGTH);
+    length += TAB_LENGTH;
+    if (hex) {
+      int_to_hex(line + length, argv[i]);
+    } else {
+      int_to_dec(line + length, argv[i]);
+    }
+    length += strlen(line + length);
+  }
+  memcpy(line + length, NEWLINE_STRING, NEWLINE_LENGTH);
+  length += NEWLINE_LENGTH;
+
+  // Buffer the line if there is room, or else write it out behind the batch
+  // that filled the buffer.
+  log_buffer_s* buffer = get_buffer();
+  if (buffer == NULL) {
+    write_out(NULL, 0, line, length);
+  } else if (!urgent && !log_exiting && buffer->length + length <= sizeof(buffer->bytes)) {
+    memcpy(buffer->bytes + buffer->length, line, length);
+    buffer->length += length;
+  } else {
+    write_out(buffer->bytes, buffer->length, line, length);
+    buffer->length = 0;
   }
 
-  // Emit a newline and flush the output.
-  write(OUTPUT_FD, NEWLINE_STRING, NEWLINE_LENGTH);
-  fsync(OUTPUT_FD);
-
-}
+} // emit ()
 // ==============================================================================
 
 
 
 // ==============================================================================
 /**
- * Print an debugging message.
+ * Print an debugging message, with its values in hexadecimal.
  *
  * \param msg  The string to emit as a message to `stderr`.  Cannot be longer
  *             than 256 characters.
- * \param argc Count of the variadic arguments.
- * \param ...  The variadic arguments (0 or more) of integers to be appended to
- *             the output.
+ * \param argc Count of the integers in `argv`.
+ * \param argv The integers (0 or more) to be appended to the output.
  */
 void
-safe_debug (const char* msg, int argc, ...) {
+safe_debug (const char* msg, int argc, const uint64_t* argv) {
 
-  // Emit the debugging message.
-  va_list argp;
-  va_start(argp, argc);
-  emit("DEBUG: ", msg, argc, argp);
-  va_end(argp);
+  emit("DEBUG: ", msg, argc, argv, true, false);
   
 } // safe_debug ()
 // ==============================================================================
@@ -137,25 +330,99 @@ safe_debug (const char* msg, int argc, ...) {
 
 // ==============================================================================
 /**
- * Print an error message and abort the process.  **Does not return**
+ * Print an informational message, with its values in decimal.
+ *
+ * \param msg  The string to emit as a message to `stderr`.  Cannot be longer
+ *             than 256 characters.
+ * \param argc Count of the integers in `argv`.
+ * \param argv The integers (0 or more) to be appended to the output.
+ */
+void
+safe_info (const char* msg, int argc, const uint64_t* argv) {
+
+  emit("INFO: ", msg, argc, argv, false, false);
+
+} // safe_info ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Print an error message, along with any of the calling thread's messages not
+ * yet written, and abort the process.  **Does not return**
  *
- * \param msg The string to emit as a message to `stderr`.  Cannot be longer
- *            than 256 characters.
- * \param argc Count of the variadic arguments.
- * \param ...  The variadic arguments (0 or more) of integers to be appended to
- *             the output.
+ * \param msg  The string to emit as a message to `stderr`.  Cannot be longer
+ *             than 256 characters.
+ * \param argc Count of the integers in `argv`.
+ * \param argv The integers (0 or more) to be appended to the output.
  */
 void
-safe_error (const char* msg, int argc, ...) {
+safe_error (const char* msg, int argc, const uint64_t* argv) {
 
   // Emit the error message.
-  va_list argp;
-  va_start(argp, argc);
-  emit("ERROR: ", msg, argc, argp);
-  va_end(argp);
+  emit("ERROR: ", msg, argc, argv, true, true);
 
   // And exit with an error code.
   exit(1);
   
 } // safe_error ()
 // ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Print an error message at once, along with any of the calling thread's
+ * messages not yet written, and abort the process.  **Does not return**
+ *
+ * \param msg  The string to emit as a message to `stderr`.  Cannot be longer
+ *             than 256 characters.
+ * \param argc Count of the integers in `argv`.
+ * \param argv The integers (0 or more) to be appended to the output.
+ */
+void
+safe_fatal (const char* msg, int argc, const uint64_t* argv) {
+
+  // Write the message with a single system call, before anything else can go
+  // wrong.
+  emit("FATAL: ", msg, argc, argv, true, true);
+
+  // Abort, rather than exit, so that no exit handler runs on a corrupt heap.
+  abort();
+
+} // safe_fatal ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/** Write whatever messages the calling thread has buffered. */
+void
+safe_flush () {
+
+  log_buffer_s* buffer = log_buffer;
+  if (buffer != NULL && buffer->length > 0) {
+    write_out(buffer->bytes, buffer->length, NULL, 0);
+    buffer->length = 0;
+  }
+
+} // safe_flush ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * At exit, write the exiting thread's buffered messages, and any later ones at
+ * once.  Other threads still running lose whatever they have buffered.
+ */
+__attribute__ ((destructor))
+static void
+log_flush_at_exit () {
+
+  log_exiting = true;
+  safe_flush();
+
+} // log_flush_at_exit ()
+// ==============================================================================
@@ -3,6 +3,11 @@
  * safeio.h
  *
  * Safe I/O (well, just O) functions that do not rely on heap allocation.
+ *
+ * Messages are buffered per thread and written in batches, each with a single
+ * system call, so that lines from different threads never interleave.  A
+ * thread's batch is written when its buffer fills, when it reports an error,
+ * when it calls `safe_flush()`, and when it (or the process) exits.
  **/
 // ==============================================================================
 
@@ -17,17 +22,39 @@
 
 
 
+// ==============================================================================
+// INCLUDES
+
+#include <stdint.h>
+// ==============================================================================
+
+
+
 // ==============================================================================
 // MACROS
 
-#define NUMARGS(...)  (sizeof((int[]){__VA_ARGS__})/sizeof(int))
+/**
+ * Count the integer arguments of a message.  Each is converted to a
+ * `uint64_t`, so values of any integer type, `size_t` and `intptr_t`
+ * included, are written in full.
+ */
+#define NUMARGS(...)  (sizeof((uint64_t[]){__VA_ARGS__})/sizeof(uint64_t))
+
+/** Gather the integer arguments of a message into an array. */
+#define ARGS(...)     ((const uint64_t[]){__VA_ARGS__})
 
 /** Emit an error message. */
-#define ERROR(msg,...) safe_error(msg, NUMARGS(__VA_ARGS__), ##__VA_ARGS__)
+#define ERROR(msg,...) safe_error(msg, NUMARGS(__VA_ARGS__), ARGS(__VA_ARGS__))
+
+/** Emit an informational message, with its values in decimal. */
+#define INFO(msg,...)  safe_info(msg, NUMARGS(__VA_ARGS__), ARGS(__VA_ARGS__))
+
+/** Emit a message about a corrupted heap, and abort at once. */
+#define FATAL(msg,...) safe_fatal(msg, NUMARGS(__VA_ARGS__), ARGS(__VA_ARGS__))
 
 /** Emit a debugging message (or, if disabled, remove such output). */
 #if defined (DEBUG_ALLOC)
-#define DEBUG(msg,...) safe_debug(msg, NUMARGS(__VA_ARGS__), ##__VA_ARGS__)
+#define DEBUG(msg,...) safe_debug(msg, NUMARGS(__VA_ARGS__), ARGS(__VA_ARGS__))
 #else
 #define DEBUG(msg,...)
 #endif /* DEBUG_ALLOC */
@@ -37,26 +64,51 @@
 
 // ==============================================================================
 /**
- * Print an debugging message.
+ * Print an debugging message, with its values in hexadecimal.
  *
  * \param msg  The string to emit as a message to `stderr`.  Cannot be longer
  *             than 256 characters.
- * \param argc Count of the variadic arguments.
- * \param ...  The variadic arguments (0 or more) of integers to be appended to
- *             the output.
+ * \param argc Count of the integers in `argv`.
+ * \param argv The integers (0 or more) to be appended to the output.
  */
-void safe_debug (const char* msg, int argc, ...);
+void safe_debug (const char* msg, int argc, const uint64_t* argv);
 
 /**
- * Print an error message and abort the process.  **Does not return**
+ * Print an informational message, with its values in decimal.
  *
- * \param msg The string to emit as a message to `stderr`.  Cannot be longer
- *            than 256 characters.
- * \param argc Count of the variadic arguments.
- * \param ...  The variadic arguments (0 or more) of integers to be appended to
- *             the output.
+ * \param msg  The string to emit as a message to `stderr`.  Cannot be longer
+ *             than 256 characters.
+ * \param argc Count of the integers in `argv`.
+ * \param argv The integers (0 or more) to be appended to the output.
  */
-void safe_error (const char* msg, int argc, ...);
+void safe_info (const char* msg, int argc, const uint64_t* argv);
+
+/**
+ * Print an error message, along with any of the calling thread's messages not
+ * yet written, and abort the process.  **Does not return**
+ *
+ * \param msg  The string to emit as a message to `stderr`.  Cannot be longer
+ *             than 256 characters.
+ * \param argc Count of the integers in `argv`.
+ * \param argv The integers (0 or more) to be appended to the output.
+ */
+void safe_error (const char* msg, int argc, const uint64_t* argv);
+
+/**
+ * Print an error message at once, along with any of the calling thread's
+ * messages not yet written, and abort the process with `SIGABRT`, without
+ * running exit handlers.  For errors after which the heap cannot be trusted.
+ * **Does not return**
+ *
+ * \param msg  The string to emit as a message to `stderr`.  Cannot be longer
+ *             than 256 characters.
+ * \param argc Count of the integers in `argv`.
+ * \param argv The integers (0 or more) to be appended to the output.
+ */
+void safe_fatal (const char* msg, int argc, const uint64_t* argv);
+
+/** Write whatever messages the calling thread has buffered. */
+void safe_flush (void);
 // ==============================================================================
 
 
@@ -0,0 +1,778 @@
+// ==============================================================================
+/**
+ * sf-alloc.c
+ *
+ * A _segregated-fit_ (slab) heap allocator.  Each request is rounded up to a
+ * size class, and every slab -- a single page for the small classes, a few
+ * pages for the larger ones -- holds objects of just one class.  A slab
+ * records which of its slots are free in a bitmap, so objects carry no header
+ * at all:  `free()` finds an object's slab, and thus its size, through a
+ * per-page table.  Requests larger than every class get their own mapping.
+ * An aligned block lies within a slot (or mapping) large enough to hold it at
+ * any offset; an object is found from any address within it, so nothing need
+ * record where the aligned block starts.
+ **/
+// ==============================================================================
+
+
+
+// ==============================================================================
+// INCLUDES
+
+#include <assert.h>
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "safeio.h"
+// ==============================================================================
+
+
+
+// ==============================================================================
+// MACRO CONSTANTS AND FUNCTIONS
+
+/**
+ * Macros to easily calculate the number of bytes for larger scales (e.g., kilo,
+ * mega, gigabytes).
+ */
+#define KB(size)  ((size_t)size * 1024)
+#define MB(size)  (KB(size) * 1024)
+#define GB(size)  (MB(size) * 1024)
+
+/** The virtual address space reserved for slabs. */
+#define HEAP_SIZE GB(2)
+
+/**
+ * The unit in which slabs are carved from the heap, and the size of every slab
+ * for the small classes.  Fixed, rather than the system's page size, so that
+ * the bitmaps have a fixed size too.
+ */
+#define SLAB_PAGE KB(4)
+
+/** The alignment of every object.  Must be a power of 2. */
+#define BLOCK_ALIGN 16
+
+/** Round `addr` up (or down) to a multiple of `align`, which must be a power of 2. */
+#define ALIGN_UP(addr, align)   (((addr) + ((intptr_t)(align) - 1)) & ~((intptr_t)(align) - 1))
+#define ALIGN_DOWN(addr, align) ((addr) & ~((intptr_t)(align) - 1))
+
+/**
+ * Size classes.  The first `LINEAR_CLASSES` are `BLOCK_ALIGN` apart; above
+ * them, each power of two is divided into `CLASSES_PER_DOUBLING` classes, up
+ * to `CLASS_MAX`.
+ */
+#define LINEAR_CLASSES       8
+#define LINEAR_CLASS_MAX     (LINEAR_CLASSES * BLOCK_ALIGN)
+#define CLASSES_PER_DOUBLING 4
+#define CLASS_MAX            KB(32)
+#define NUM_CLASSES          40
+
+/** The number of objects a slab should hold, when it spans more than a page. */
+#define OBJECTS_PER_SLAB 8
+
+/** The most slots that any slab can have, and the words of bitmap to track them. */
+#define MAX_SLOTS    (SLAB_PAGE / BLOCK_ALIGN)
+#define BITMAP_WORDS (MAX_SLOTS / 64)
+
+/** The class recorded for a large block, which has a mapping all its own. */
+#define LARGE_CLASS UINT32_MAX
+// ==============================================================================
+
+
+
+// ==============================================================================
+// TYPES AND STRUCTURES
+
+/**
+ * The header at the start of every slab, and of the mapping of every large
+ * block.  Objects begin at the first aligned address after it.
+ */
+typedef struct slab {
+
+  /** The next slab of the same class that has a free slot. */
+  struct slab* next;
+
+  /** The slab's size class, or `LARGE_CLASS`. */
+  uint32_t     class;
+
+  /** The number of free slots. */
+  uint32_t     free_count;
+
+  /**
+   * The size of each object, in bytes; for a large block, the length of its
+   * whole mapping.
+   */
+  size_t       size;
+
+  /** One bit per slot, set when the slot is free. */
+  uint64_t     free_slots[BITMAP_WORDS];
+
+} slab_s;
+
+/** The offset of the first object in a slab. */
+#define SLAB_HEADER_SIZE ALIGN_UP(sizeof(slab_s), BLOCK_ALIGN)
+
+/** The slabs of one size class. */
+typedef struct size_class {
+
+  /** The slabs that have at least one free slot.  A full slab is on no list. */
+  slab_s*         partial;
+
+  /** Serializes operations on this class's slabs. */
+  pthread_mutex_t lock;
+
+} size_class_s;
+// ==============================================================================
+
+
+
+// ==============================================================================
+// GLOBALS
+
+/** The address of the next available byte in the slab region. */
+static intptr_t free_addr  = 0;
+
+/** The beginning of the slab region. */
+static intptr_t start_addr = 0;
+
+/** The end of the slab region. */
+static intptr_t end_addr   = 0;
+
+/** For each `SLAB_PAGE` of the region, the slab that it belongs to. */
+static slab_s** page_map   = NULL;
+
+/** The state of each size class. */
+static size_class_s classes[NUM_CLASSES];
+
+/** Serializes `init()`. */
+static pthread_mutex_t init_lock = PTHREAD_MUTEX_INITIALIZER;
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * The initialization method.  If this is the first use of the heap, initialize it.
+ */
+
+void init () {
+
+  if (__atomic_load_n(&start_addr, __ATOMIC_ACQUIRE) != 0) {
+    return;
+  }
+
+  pthread_mutex_lock(&init_lock);
+
+  // Only do anything if there is no heap region (i.e., first time called).
+  if (start_addr == 0) {
+
+    DEBUG("Trying to initialize");
+
+    // Allocate virtual address space in which the slabs will reside, plus the
+    // table that maps each of its pages to its slab.  Neither is charged
+    // against the system until touched.  A failure to map either is fatal.
+    void* heap = mmap(NULL,
+		      HEAP_SIZE,
+		      PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+		      -1,
+		      0);
+    void* map  = mmap(NULL,
+		      HEAP_SIZE / SLAB_PAGE * sizeof(slab_s*),
+		      PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+		      -1,
+		      0);
+    if (heap == MAP_FAILED || map == MAP_FAILED) {
+      ERROR("Could not mmap() heap region");
+    }
+
+    for (int class = 0; class < NUM_CLASSES; class += 1) {
+      classes[class].partial = NULL;
+      pthread_mutex_init(&classes[class].lock, NULL);
+    }
+
+    // Hold onto the boundaries of the heap as a whole.
+    page_map   = (slab_s**)map;
+    end_addr   = (intptr_t)heap + HEAP_SIZE;
+    free_addr  = (intptr_t)heap;
+    __atomic_store_n(&start_addr, (intptr_t)heap, __ATOMIC_RELEASE);
+
+    // DEBUG: Emit a message to indicate that this allocator is being called.
+    DEBUG("sf-alloc initialized");
+
+  }
+
+  pthread_mutex_unlock(&init_lock);
+
+} // init ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+// SIZE CLASSES
+
+/**
+ * Find the size class for a request.
+ *
+ * \param size The number of bytes needed; at least 1 and at most `CLASS_MAX`.
+ * \return     The index of the smallest class that holds `size` bytes.
+ */
+static int size_class (size_t size) {
+
+  if (size <= LINEAR_CLASS_MAX) {
+    return (size - 1) / BLOCK_ALIGN;
+  }
+
+  // Above the linear classes, the doubling [2^p, 2^(p+1)) that holds size - 1
+  // picks a group of classes, and the next two bits pick one of them.
+  int log2_size = 63 - __builtin_clzll(size - 1);
+  int doubling  = log2_size - __builtin_ctzll(LINEAR_CLASS_MAX);
+  int step      = log2_size - __builtin_ctzll(CLASSES_PER_DOUBLING);
+  return LINEAR_CLASSES + doubling * CLASSES_PER_DOUBLING
+         + (((size - 1) >> step) & (CLASSES_PER_DOUBLING - 1));
+
+} // size_class ()
+
+/** The size of each object in a given size class. */
+static size_t class_size (int class) {
+
+  if (class < LINEAR_CLASSES) {
+    return (size_t)(class + 1) * BLOCK_ALIGN;
+  }
+  int    doubling = (class - LINEAR_CLASSES) / CLASSES_PER_DOUBLING;
+  int    step     = (class - LINEAR_CLASSES) % CLASSES_PER_DOUBLING;
+  size_t base     = LINEAR_CLASS_MAX << doubling;
+  return base + (step + 1) * (base / CLASSES_PER_DOUBLING);
+
+} // class_size ()
+
+/** The number of bytes in each slab of a given size class. */
+static size_t slab_size (int class) {
+
+  size_t wanted = SLAB_HEADER_SIZE + OBJECTS_PER_SLAB * class_size(class);
+  return wanted <= SLAB_PAGE ? SLAB_PAGE : ALIGN_UP(wanted, SLAB_PAGE);
+
+} // slab_size ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Carve a new, entirely free slab for a size class from the slab region.
+ *
+ * \param class The size class of the new slab.
+ * \return      The slab, if successful; `NULL` if the region is full.
+ */
+static slab_s* new_slab (int class) {
+
+  // Claim the space with an atomic bump, so that classes need not share a lock.
+  size_t   length    = slab_size(class);
+  intptr_t slab_addr = __atomic_fetch_add(&free_addr, length, __ATOMIC_RELAXED);
+  if (slab_addr > end_addr - (intptr_t)length) {
+    return NULL;
+  }
+
+  slab_s* slab     = (slab_s*)slab_addr;
+  size_t  size     = class_size(class);
+  size_t  slots    = (length - SLAB_HEADER_SIZE) / size;
+  assert(slots <= MAX_SLOTS);
+
+  slab->next       = NULL;
+  slab->class      = class;
+  slab->free_count = slots;
+  slab->size       = size;
+  for (size_t word = 0; word < BITMAP_WORDS; word += 1) {
+    size_t first      = word * 64;
+    slab->free_slots[word] = (slots <= first)      ? 0
+                           : (slots >= first + 64) ? ~(uint64_t)0
+                           : ((uint64_t)1 << (slots - first)) - 1;
+  }
+
+  // Point every page of the slab back at its header.
+  size_t first_page = (slab_addr - start_addr) / SLAB_PAGE;
+  for (size_t page = 0; page < length / SLAB_PAGE; page += 1) {
+    page_map[first_page + page] = slab;
+  }
+
+  return slab;
+
+} // new_slab ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Find the slab (or large block header) that holds an object.
+ *
+ * \param ptr A pointer returned by `malloc()` or an aligned allocator.
+ * \return    The header describing the object.
+ */
+static slab_s* find_slab (void* ptr) {
+
+  intptr_t addr = (intptr_t)ptr;
+  if (addr >= start_addr && addr < end_addr) {
+    return page_map[(addr - start_addr) / SLAB_PAGE];
+  }
+
+  // A large block lies past a header at the start of a page of its own
+  // mapping:  just past it, unless the block is aligned.
+  return (slab_s*)ALIGN_DOWN(addr - (intptr_t)SLAB_HEADER_SIZE, SLAB_PAGE);
+
+} // find_slab ()
+
+/**
+ * The number of usable bytes from a pointer to the end of its object.
+ *
+ * \param slab The header describing the object.
+ * \param ptr  A pointer into the object.
+ */
+static size_t usable_size (slab_s* slab, void* ptr) {
+
+  intptr_t addr = (intptr_t)ptr;
+  if (slab->class == LARGE_CLASS) {
+    return (intptr_t)slab + slab->size - addr;
+  }
+  size_t offset = addr - (intptr_t)slab - SLAB_HEADER_SIZE;
+  return slab->size - offset % slab->size;
+
+} // usable_size ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate a large block in its own mapping, headed by a `slab_s` that records
+ * the mapping's length.  An aligned block is mapped with room to spare, which
+ * is then unmapped, leaving the header in the page at or before the block.
+ *
+ * \param size  The number of bytes to allocate.
+ * \param align The alignment of the block; a power of 2.
+ * \return      A pointer to the allocated block, if successful; `NULL` if
+ *              unsuccessful.
+ */
+static void* large_malloc (size_t size, size_t align) {
+
+  if (size > HEAP_SIZE || align > HEAP_SIZE) {
+    return NULL;
+  }
+
+  size_t spare  = (align > BLOCK_ALIGN) ? align : 0;
+  size_t length = ALIGN_UP(SLAB_HEADER_SIZE + size + spare, SLAB_PAGE);
+  void*  map    = mmap(NULL,
+		       length,
+		       PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS,
+		       -1,
+		       0);
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+
+  intptr_t map_addr    = (intptr_t)map;
+  intptr_t block_addr  = ALIGN_UP(map_addr + (intptr_t)SLAB_HEADER_SIZE, align);
+  intptr_t header_addr = ALIGN_DOWN(block_addr - (intptr_t)SLAB_HEADER_SIZE, SLAB_PAGE);
+  intptr_t map_end     = ALIGN_UP(block_addr + (intptr_t)size, SLAB_PAGE);
+  if (header_addr > map_addr) {
+    munmap(map, header_addr - map_addr);
+  }
+  if (map_end < map_addr + (intptr_t)length) {
+    munmap((void*)map_end, map_addr + length - map_end);
+  }
+
+  slab_s* header = (slab_s*)header_addr;
+  header->class  = LARGE_CLASS;
+  header->size   = map_end - header_addr;
+  return (void*)block_addr;
+
+} // large_malloc ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate and return `size` bytes of heap space:  take the first free slot in
+ * a slab of the request's size class.
+ *
+ * \param size The number of bytes to allocate.
+ * \return     A pointer to the allocated block, if successful; `NULL` if
+ *             unsuccessful.
+ */
+void* malloc (size_t size) {
+
+  init();
+
+  // if requested size is 0, return nothing because there is nothing to do
+  if (size == 0) {
+    return NULL;
+  }
+  if (size > CLASS_MAX) {
+    return large_malloc(size, BLOCK_ALIGN);
+  }
+
+  int           class = size_class(size);
+  size_class_s* sc    = &classes[class];
+  pthread_mutex_lock(&sc->lock);
+
+  slab_s* slab = sc->partial;
+  if (slab == NULL) {
+    slab = new_slab(class);
+    if (slab == NULL) {
+      pthread_mutex_unlock(&sc->lock);
+      return NULL;
+    }
+    sc->partial = slab;
+  }
+
+  // Claim the lowest free slot.  A slab that fills up leaves the partial list;
+  // since allocation always takes from the head, it is always the head.
+  int word = 0;
+  while (slab->free_slots[word] == 0) {
+    word += 1;
+  }
+  int slot = word * 64 + __builtin_ctzll(slab->free_slots[word]);
+  slab->free_slots[word] &= slab->free_slots[word] - 1;
+  slab->free_count       -= 1;
+  if (slab->free_count == 0) {
+    sc->partial = slab->next;
+    slab->next  = NULL;
+  }
+
+  pthread_mutex_unlock(&sc->lock);
+  return (void*)((intptr_t)slab + SLAB_HEADER_SIZE + slot * slab->size);
+
+} // malloc()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Deallocate a given block on the heap:  mark its slot free, or unmap it if it
+ * is a large block.
+ *
+ * \param ptr A pointer to the block to be deallocated.
+ */
+void free (void* ptr) {
+
+  DEBUG("free(): ", (intptr_t)ptr);
+
+  if (ptr == NULL) {
+    return;
+  }
+
+  slab_s* slab = find_slab(ptr);
+  if (slab->class == LARGE_CLASS) {
+    munmap(slab, slab->size);
+    return;
+  }
+
+  size_class_s* sc   = &classes[slab->class];
+  size_t        slot = ((intptr_t)ptr - (intptr_t)slab - SLAB_HEADER_SIZE) / slab->size;
+  pthread_mutex_lock(&sc->lock);
+
+  slab->free_slots[slot / 64] |= (uint64_t)1 << (slot % 64);
+  slab->free_count            += 1;
+
+  // A slab that was full has a free slot again.
+  if (slab->free_count == 1) {
+    slab->next  = sc->partial;
+    sc->partial = slab;
+  }
+
+  pthread_mutex_unlock(&sc->lock);
+
+} // free()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate a block of `nmemb * size` bytes on the heap, zeroing its contents.
+ *
+ * \param nmemb The number of elements in the new block.
+ * \param size  The size, in bytes, of each of the `nmemb` elements.
+ * \return      A pointer to the newly allocated and zeroed block, if successful;
+ *              `NULL` if unsuccessful.
+ */
+void* calloc (size_t nmemb, size_t size) {
+
+  // Refuse requests whose total size overflows.
+  size_t total_size;
+  if (__builtin_mul_overflow(nmemb, size, &total_size)) {
+    return NULL;
+  }
+
+  // Allocate a block of the requested size.  A large block is a fresh mapping,
+  // and so is already zeroed.
+  void* block_ptr = malloc(total_size);
+  if (block_ptr != NULL && total_size <= CLASS_MAX) {
+    memset(block_ptr, 0, total_size);
+  }
+
+  return block_ptr;
+
+} // calloc ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Update the given block at `ptr` to take on the given `size`.  If `size` fits
+ * within the block's slot (or mapping), the block is returned unchanged.
+ * Otherwise, a new and larger block is allocated, the data copied, and the old
+ * block freed.
+ *
+ * \param ptr  The block to be assigned a new size.
+ * \param size The new size that the block should assume.
+ * \return     A pointer to the resultant block, which may be `ptr` itself, or
+ *             may be a newly allocated block.
+ */
+void* realloc (void* ptr, size_t size) {
+
+  // if there is no given block, then simply return
+  // a new block of given size using malloc()
+  if (ptr == NULL) {
+    return malloc(size);
+  }
+
+  // if the requested size is 0, then free the current block as
+  // it is no longer needed. Return NULL to signify a block of size 0.
+  if (size == 0) {
+    free(ptr);
+    return NULL;
+  }
+
+  size_t old_size = usable_size(find_slab(ptr), ptr);
+  if (size <= old_size) {
+    return ptr;
+  }
+
+  void* new_ptr = malloc(size);
+  if (new_ptr != NULL) {
+    memcpy(new_ptr, ptr, old_size);
+    free(ptr);
+  }
+
+  return new_ptr;
+
+} // realloc()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Find the number of usable bytes in a block, which may exceed the size it
+ * was requested with.
+ *
+ * \param ptr A pointer to a block, or `NULL`.
+ * \return    The block's usable size; `0` for `NULL`.
+ */
+size_t malloc_usable_size (void* ptr) {
+
+  return ptr == NULL ? 0 : usable_size(find_slab(ptr), ptr);
+
+} // malloc_usable_size ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes aligned to `align`.  A block that, at any offset, fits
+ * in a slot is taken from the slot of a class large enough for that; any
+ * other gets a mapping of its own.
+ *
+ * \param align The alignment of the block; a power of 2.
+ * \param size  The number of bytes to allocate.
+ * \return      A pointer to the allocated block, if successful; `NULL` if
+ *              unsuccessful.
+ */
+static void* allocate_aligned (size_t align, size_t size) {
+
+  if (align <= BLOCK_ALIGN) {
+    return malloc(size);
+  }
+  if (size == 0) {
+    return NULL;
+  }
+
+  // Every slot is already aligned to BLOCK_ALIGN, so the aligned block starts
+  // at most align - BLOCK_ALIGN bytes into it.
+  if (size <= CLASS_MAX && align <= CLASS_MAX && size + align - BLOCK_ALIGN <= CLASS_MAX) {
+    void* slot_ptr = malloc(size + align - BLOCK_ALIGN);
+    return (slot_ptr == NULL) ? NULL : (void*)ALIGN_UP((intptr_t)slot_ptr, align);
+  }
+
+  init();
+  return large_malloc(size, align);
+
+} // allocate_aligned ()
+
+/** Determine whether `value` is a power of 2. */
+static bool is_power_of_2 (size_t value) {
+  return value != 0 && (value & (value - 1)) == 0;
+}
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes aligned to `alignment`, storing the block in
+ * `*memptr`.
+ *
+ * \param memptr    Where to store the pointer to the allocated block.
+ * \param alignment A power of 2 that is a multiple of `sizeof(void*)`.
+ * \param size      The number of bytes to allocate.
+ * \return          `0` if successful; `EINVAL` if `alignment` is invalid;
+ *                  `ENOMEM` if there is no space.
+ */
+int posix_memalign (void** memptr, size_t alignment, size_t size) {
+
+  if (!is_power_of_2(alignment) || alignment % sizeof(void*) != 0) {
+    return EINVAL;
+  }
+
+  void* block_ptr = allocate_aligned(alignment, size);
+  if (block_ptr == NULL && size != 0) {
+    return ENOMEM;
+  }
+
+  *memptr = block_ptr;
+  return 0;
+
+} // posix_memalign ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes aligned to `alignment`, as in C11.
+ *
+ * \param alignment A power of 2.
+ * \param size      The number of bytes to allocate.
+ * \return          A pointer to the allocated block, if successful; `NULL` if
+ *                  unsuccessful.
+ */
+void* aligned_alloc (size_t alignment, size_t size) {
+
+  if (!is_power_of_2(alignment)) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  return allocate_aligned(alignment, size);
+
+} // aligned_alloc ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes aligned to `alignment`.  As in glibc, an alignment
+ * that is not a power of 2 is rounded up to one.
+ *
+ * \param alignment The alignment of the block.
+ * \param size      The number of bytes to allocate.
+ * \return          A pointer to the allocated block, if successful; `NULL` if
+ *                  unsuccessful.
+ */
+void* memalign (size_t alignment, size_t size) {
+
+  if (alignment > HEAP_SIZE) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (alignment > BLOCK_ALIGN && !is_power_of_2(alignment)) {
+    alignment = (size_t)1 << (64 - __builtin_clzll(alignment));
+  }
+
+  return allocate_aligned(alignment, size);
+
+} // memalign ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes aligned to a page.
+ *
+ * \param size The number of bytes to allocate.
+ * \return     A pointer to the allocated block, if successful; `NULL` if
+ *             unsuccessful.
+ */
+void* valloc (size_t size) {
+
+  return allocate_aligned(sysconf(_SC_PAGESIZE), size);
+
+} // valloc ()
+// ==============================================================================
+
+
+
+// ==============================================================================
+/**
+ * Allocate `size` bytes, rounded up to a whole number of pages, aligned to a
+ * page.
+ *
+ * \param size The number of bytes to allocate.
+ * \return     A pointer to the allocated block, if successful; `NULL` if
+ *             unsuccessful.
+ */
+void* pvalloc (size_t size) {
+
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  if (size > HEAP_SIZE) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  return allocate_aligned(page_size, size == 0 ? page_size : ALIGN_UP(size, page_size));
+
+} // pvalloc ()
+// ==============================================================================
+
+
+
+#if defined (ALLOC_MAIN)
+// ==============================================================================
+/**
+ * The entry point if this code is compiled as a standalone program for testing
+ * purposes.
+ */
+int main () {
+
+  // Allocate a few blocks, then free them.
+  void* x = malloc(16);
+  void* y = malloc(64);
+  void* z = malloc(32);
+
+  free(z);
+  free(y);
+  free(x);
+
+  return 0;
+
+} // main()
+// ==============================================================================
+#endif